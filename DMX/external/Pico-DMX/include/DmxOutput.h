@@ -21,8 +21,37 @@
 #define DMX_UNIVERSE_SIZE 512
 #define DMX_SM_FREQ 1000000
 
+// Break (22 x 8us) + mark after break (16us) + 44us per slot at 250 kbaud
+#define DMX_FRAME_US(length) (176 + 16 + 44 * (length))
+
+// Time the last slots take to leave the TX FIFO and OSR after the DMA
+// transfer of a frame completes
+#define DMX_TAIL_US (44 * 5)
+
+// Completion interrupt of every output. DmxInput claims DMA_IRQ_0 exclusively,
+// so outputs share DMA_IRQ_1
+#define DMX_OUTPUT_DMA_IRQ DMA_IRQ_1
+
 class DmxOutput
 {
+public:
+    /*
+        Called from the refresh alarm interrupt at the start of every
+        frame in continuous mode. Returns the universe to transmit and
+        stores its length (start code included) in *length.
+    */
+    typedef uint8_t *(*frame_callback)(DmxOutput *instance, uint *length, void *user_data);
+
+    /*
+        Called from the DMA interrupt once the last slot of a frame has
+        been handed to the state machine. The final few slots are still
+        being shifted out of the TX FIFO at that point (at most
+        DMX_TAIL_US), but the universe buffer is no longer read and the
+        next frame can be composed.
+    */
+    typedef void (*done_callback)(DmxOutput *instance, void *user_data);
+
+private:
     uint _prgm_offset;
     uint _pin;
     uint _sm;
@@ -30,6 +59,19 @@ class DmxOutput
     uint _dma;
     bool _inverted;
 
+    bool _paced = false;
+    uint32_t _period_us;
+    uint64_t _next_frame_us;
+    frame_callback _frame_cb;
+    void *_frame_user_data;
+
+    done_callback _done_cb = nullptr;
+    void *_done_user_data;
+
+    static void dma_irq_handler();
+    static void refresh_alarm_handler(uint alarm_num);
+    static void rearm_refresh_alarm(uint alarm_num);
+
 public:
     uint getprgm_offset() {return _prgm_offset;};
     /*
@@ -51,7 +93,11 @@ public:
 
         // There are no available DMA channels to handle
         // the transfer of DMX data to the PIO
-        ERR_NO_DMA_AVAILABLE = -3
+        ERR_NO_DMA_AVAILABLE = -3,
+
+        // There are no available hardware timer alarms
+        // to pace continuous output
+        ERR_NO_ALARM_AVAILABLE = -4
     };
 
     /*
@@ -88,6 +134,41 @@ public:
 
     void write_dmx(uint8_t *universe, uint length);
 
+    /*
+        Start hardware paced output. A hardware timer alarm fires every
+        1 / refresh_hz seconds and restarts the transmission from its
+        interrupt handler, so frame timing is set by the timer and not by
+        task scheduling. If a frame is still on the wire when the alarm
+        fires, that refresh is skipped.
+
+        All continuous outputs share a single hardware alarm, which is
+        always re-armed for the earliest pending frame, so every output
+        can run at its own rate. The alarm interrupt is serviced on the
+        core that started the first continuous output.
+
+        Param: refresh_hz
+        Frames per second. A full 513 slot universe takes 22.8ms, so
+        anything above 43Hz only helps shorter universes.
+
+        Param: frame_cb
+        Supplies the universe for each frame, see frame_callback.
+    */
+    return_code start_continuous(uint refresh_hz, frame_callback frame_cb, void *user_data = nullptr);
+
+    /*
+        Change the refresh rate of a running continuous output.
+        Takes effect from the next frame.
+    */
+    void set_refresh_rate(uint refresh_hz);
+
+    /*
+        Stop continuous output. The hardware alarm is released once no
+        output uses it. The frame currently on the wire is allowed to finish.
+    */
+    void stop_continuous();
+
+    bool continuous() {return _paced;};
+
     /*
         Checks whether the DMX transmitter is busy sending
         a DMX data frame. Returns immediately
@@ -97,10 +178,17 @@ public:
     /*
         Wait for the DMX transmitter to finish transmitting
         the current DMX frame. Returns immediately if no
-        frame is currently being transmitted
+        frame is currently being transmitted. Spins; callers
+        running under an RTOS should sleep on on_frame_done()
+        instead
     */
+    void await();
 
-    // void await();
+    /*
+        Register a function to be called from the DMA interrupt at the
+        end of every frame, see done_callback. Pass nullptr to remove it.
+    */
+    void on_frame_done(done_callback done_cb, void *user_data = nullptr);
 
     /*
         De-inits the DMX transmitter instance. Releases PIO 
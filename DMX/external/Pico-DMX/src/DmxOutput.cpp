@@ -14,8 +14,22 @@
 #else
   #include "hardware/clocks.h"
   #include "hardware/irq.h"
+  #include "hardware/timer.h"
 #endif
 
+#include "hardware/sync.h"
+
+// Every continuous output, serviced by one shared hardware alarm.
+// There can be no more outputs than there are state machines.
+#define NUM_PACED_OUTPUTS 8
+static DmxOutput *volatile paced_outputs[NUM_PACED_OUTPUTS] = {nullptr};
+static int refresh_alarm = -1;
+
+// Maps each DMA channel back to the output it feeds, for the completion interrupt
+#define NUM_DMA_CHANS 12
+static DmxOutput *volatile dma_outputs[NUM_DMA_CHANS] = {nullptr};
+static bool dma_irq_installed = false;
+
 DmxOutput::return_code DmxOutput::begin(uint pin, uint prgm_offset, PIO pio ,bool inverted)
 {
     _inverted = inverted;
@@ -87,6 +101,16 @@ DmxOutput::return_code DmxOutput::begin(uint pin, uint prgm_offset, PIO pio ,boo
     // Apply the config
     dma_channel_set_config(dma, &dma_conf, false);
 
+    // Raise the shared completion interrupt at the end of every frame
+    dma_outputs[dma] = this;
+    if (!dma_irq_installed)
+    {
+        irq_add_shared_handler(DMX_OUTPUT_DMA_IRQ, dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(DMX_OUTPUT_DMA_IRQ, true);
+        dma_irq_installed = true;
+    }
+    dma_channel_set_irq1_enabled(dma, true);
+
     // Set member values of C++ class
     _prgm_offset = prgm_offset;
     _pio = pio;
@@ -102,7 +126,12 @@ void DmxOutput::write_dmx(uint8_t *universe, uint length)
 
     // Temporarily disable the PIO state machine
     pio_sm_set_enabled(_pio, _sm, false);
+    // An abort can raise a spurious completion interrupt (RP2040-E13),
+    // so mask it while the channel is stopped
+    dma_channel_set_irq1_enabled(_dma, false);
     dma_channel_abort(_dma);
+    dma_channel_acknowledge_irq1(_dma);
+    dma_channel_set_irq1_enabled(_dma, true);
     // Reset the PIO state machine to a consistent state. Clear the buffers and registers
     pio_sm_restart(_pio, _sm);
 
@@ -119,6 +148,147 @@ void DmxOutput::write_dmx(uint8_t *universe, uint length)
     dma_channel_transfer_from_buffer_now(_dma, universe, length);
 }
 
+void DmxOutput::dma_irq_handler()
+{
+    for (int i = 0; i < NUM_DMA_CHANS; i++)
+    {
+        DmxOutput *instance = dma_outputs[i];
+        if (instance == nullptr || !dma_channel_get_irq1_status(i))
+            continue;
+        dma_channel_acknowledge_irq1(i);
+        if (instance->_done_cb != nullptr)
+            instance->_done_cb(instance, instance->_done_user_data);
+    }
+}
+
+void DmxOutput::on_frame_done(done_callback done_cb, void *user_data)
+{
+    uint32_t save = save_and_disable_interrupts();
+    _done_user_data = user_data;
+    _done_cb = done_cb;
+    restore_interrupts(save);
+}
+
+void DmxOutput::refresh_alarm_handler(uint alarm_num)
+{
+    uint64_t now = time_us_64();
+    for (int i = 0; i < NUM_PACED_OUTPUTS; i++)
+    {
+        DmxOutput *instance = paced_outputs[i];
+        if (instance == nullptr || instance->_next_frame_us > now)
+            continue;
+
+        // Schedule against the previous target rather than "now" so interrupt
+        // latency never accumulates into drift. Refreshes that were missed
+        // entirely are dropped
+        do {
+            instance->_next_frame_us += instance->_period_us;
+        } while (instance->_next_frame_us <= now);
+
+        if (instance->busy())
+            continue;
+
+        uint length = 0;
+        uint8_t *universe = instance->_frame_cb(instance, &length, instance->_frame_user_data);
+        if (universe == nullptr || length == 0)
+            continue;
+        instance->write_dmx(universe, length);
+
+        // The refresh rate is an upper bound; a frame longer than the
+        // period pushes the next one back instead of finding us busy
+        uint64_t done = now + DMX_FRAME_US(length);
+        if (instance->_next_frame_us < done)
+            instance->_next_frame_us = done;
+    }
+    rearm_refresh_alarm(alarm_num);
+}
+
+/*
+    Point the shared alarm at the earliest pending frame. set_target
+    returns true when that time has already passed, in which case the
+    due outputs are serviced immediately instead.
+*/
+void DmxOutput::rearm_refresh_alarm(uint alarm_num)
+{
+    uint64_t next = UINT64_MAX;
+    for (int i = 0; i < NUM_PACED_OUTPUTS; i++)
+    {
+        DmxOutput *instance = paced_outputs[i];
+        if (instance != nullptr && instance->_next_frame_us < next)
+            next = instance->_next_frame_us;
+    }
+    if (next == UINT64_MAX)
+        return;
+    if (hardware_alarm_set_target(alarm_num, next))
+        refresh_alarm_handler(alarm_num);
+}
+
+DmxOutput::return_code DmxOutput::start_continuous(uint refresh_hz, frame_callback frame_cb, void *user_data)
+{
+    if (refresh_alarm < 0)
+    {
+        int alarm = hardware_alarm_claim_unused(false);
+        if (alarm == -1)
+            return ERR_NO_ALARM_AVAILABLE;
+        refresh_alarm = alarm;
+        hardware_alarm_set_callback(refresh_alarm, refresh_alarm_handler);
+    }
+
+    uint32_t save = save_and_disable_interrupts();
+    _frame_cb = frame_cb;
+    _frame_user_data = user_data;
+    set_refresh_rate(refresh_hz);
+    _next_frame_us = time_us_64() + _period_us;
+    if (!_paced)
+    {
+        for (int i = 0; i < NUM_PACED_OUTPUTS; i++)
+        {
+            if (paced_outputs[i] == nullptr)
+            {
+                paced_outputs[i] = this;
+                _paced = true;
+                break;
+            }
+        }
+    }
+    rearm_refresh_alarm(refresh_alarm);
+    restore_interrupts(save);
+    return SUCCESS;
+}
+
+void DmxOutput::set_refresh_rate(uint refresh_hz)
+{
+    if (refresh_hz == 0)
+        refresh_hz = 1;
+    _period_us = 1000000 / refresh_hz;
+}
+
+void DmxOutput::stop_continuous()
+{
+    if (!_paced)
+        return;
+
+    uint32_t save = save_and_disable_interrupts();
+    bool in_use = false;
+    for (int i = 0; i < NUM_PACED_OUTPUTS; i++)
+    {
+        if (paced_outputs[i] == this)
+            paced_outputs[i] = nullptr;
+        else if (paced_outputs[i] != nullptr)
+            in_use = true;
+    }
+    _paced = false;
+    restore_interrupts(save);
+
+    if (!in_use)
+    {
+        hardware_alarm_cancel(refresh_alarm);
+        hardware_alarm_set_callback(refresh_alarm, nullptr);
+        hardware_alarm_unclaim(refresh_alarm);
+        refresh_alarm = -1;
+    }
+}
+
 bool DmxOutput::busy()
 {
     if (dma_channel_is_busy(_dma))
@@ -127,8 +297,7 @@ bool DmxOutput::busy()
     return !pio_sm_is_tx_fifo_empty(_pio, _sm);
 }
 
-/*
-void Dmx::await()
+void DmxOutput::await()
 {
     dma_channel_wait_for_finish_blocking(_dma);
 
@@ -136,10 +305,11 @@ void Dmx::await()
     {
     }
 }
-*/
 
 void DmxOutput::end()
 {
+    stop_continuous();
+
     // Stop the PIO state machine
     pio_sm_set_enabled(_pio, _sm, false);
 
@@ -147,6 +317,10 @@ void DmxOutput::end()
     pio_remove_program(_pio, &DmxOutput_program, _prgm_offset);
 
     // Unclaim the DMA channel
+    dma_channel_set_irq1_enabled(_dma, false);
+    dma_channel_abort(_dma);
+    dma_channel_acknowledge_irq1(_dma);
+    dma_outputs[_dma] = nullptr;
     dma_channel_unclaim(_dma);
 
     // Unclaim the sm
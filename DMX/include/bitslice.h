@@ -0,0 +1,62 @@
+#ifndef _bit_slice_h_
+#define _bit_slice_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BITSLICE_LANES 8
+
+/*
+    Transposes up to 8 universes into the bit-sliced layout clocked out
+    by the parallel DMX program. Every slot becomes 8 bytes, one per data
+    bit (LSB first), and bit n of each byte belongs to universe n:
+
+        out byte 8 * slot + b, bit n  ==  universes[n][slot], bit b
+
+    Each slot is an 8x8 bit matrix transpose done with three
+    swap-by-mask steps on two 32-bit words (Hacker's Delight 7-3), so
+    the cost per slot is constant and branch free. A null universe
+    transmits zeros.
+
+    out must hold 2 * length words.
+*/
+static inline void bitslice_transpose(const uint8_t *const universes[BITSLICE_LANES], uint32_t *out,
+                                      size_t length) {
+    static const uint8_t zero = 0;
+    const uint8_t *in[BITSLICE_LANES];
+    size_t step[BITSLICE_LANES];
+    for (int n = 0; n < BITSLICE_LANES; n++) {
+        in[n] = universes[n] ? universes[n] : &zero;
+        step[n] = universes[n] ? 1 : 0;
+    }
+
+    for (size_t s = 0; s < length; s++) {
+        // Row n of the matrix is universe n, packed little endian
+        uint32_t lo = in[0][0] | (in[1][0] << 8) | (in[2][0] << 16) | ((uint32_t)in[3][0] << 24);
+        uint32_t hi = in[4][0] | (in[5][0] << 8) | (in[6][0] << 16) | ((uint32_t)in[7][0] << 24);
+        for (int n = 0; n < BITSLICE_LANES; n++)
+            in[n] += step[n];
+
+        uint32_t t;
+        // Swap 1x1 blocks across the diagonal of each 2x2 block
+        t = (lo ^ (lo >> 7)) & 0x00AA00AAu;
+        lo = lo ^ t ^ (t << 7);
+        t = (hi ^ (hi >> 7)) & 0x00AA00AAu;
+        hi = hi ^ t ^ (t << 7);
+        // Swap 2x2 blocks within each 4x4 block
+        t = (lo ^ (lo >> 14)) & 0x0000CCCCu;
+        lo = lo ^ t ^ (t << 14);
+        t = (hi ^ (hi >> 14)) & 0x0000CCCCu;
+        hi = hi ^ t ^ (t << 14);
+        // Swap the off-diagonal 4x4 blocks
+        t = ((lo >> 4) & 0x0F0F0F0Fu) | (hi & 0xF0F0F0F0u);
+        lo = (lo & 0x0F0F0F0Fu) | ((hi << 4) & 0xF0F0F0F0u);
+        hi = t;
+
+        out[0] = lo;
+        out[1] = hi;
+        out += 2;
+    }
+}
+
+#endif // _bit_slice_h_
@@ -0,0 +1,133 @@
+#ifndef _chan_set_h_
+#define _chan_set_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CHANSET_CHANNELS 512
+#define CHANSET_WORDS (CHANSET_CHANNELS / 32)
+
+/*
+    Fixed 64 byte set of DMX channels 1..512. Channel n is held in bit
+    (n - 1) so the whole universe fits in 16 words, and every set
+    operation is a loop over those words with no allocation.
+*/
+class ChannelSet {
+    public:
+    ChannelSet() {clear();};
+
+    void clear() {for (int i = 0; i < CHANSET_WORDS; i++) words[i] = 0;};
+    void fill() {for (int i = 0; i < CHANSET_WORDS; i++) words[i] = 0xFFFFFFFFu;};
+
+    bool test(unsigned channel) const {
+        if (channel < 1 || channel > CHANSET_CHANNELS)
+            return false;
+        return words[(channel - 1) >> 5] & (1u << ((channel - 1) & 31));
+    };
+    void set(unsigned channel) {
+        if (channel >= 1 && channel <= CHANSET_CHANNELS)
+            words[(channel - 1) >> 5] |= 1u << ((channel - 1) & 31);
+    };
+    void reset(unsigned channel) {
+        if (channel >= 1 && channel <= CHANSET_CHANNELS)
+            words[(channel - 1) >> 5] &= ~(1u << ((channel - 1) & 31));
+    };
+
+    /*
+        Set or reset channels first..last (inclusive) using whole word
+        masks, so a THRU range costs at most 16 word writes.
+    */
+    void setRange(unsigned first, unsigned last) {range(first, last, true);};
+    void resetRange(unsigned first, unsigned last) {range(first, last, false);};
+
+    ChannelSet &operator|=(const ChannelSet &o) {
+        for (int i = 0; i < CHANSET_WORDS; i++) words[i] |= o.words[i];
+        return *this;
+    };
+    ChannelSet &operator&=(const ChannelSet &o) {
+        for (int i = 0; i < CHANSET_WORDS; i++) words[i] &= o.words[i];
+        return *this;
+    };
+    // Set difference: remove every channel that is in o
+    ChannelSet &operator-=(const ChannelSet &o) {
+        for (int i = 0; i < CHANSET_WORDS; i++) words[i] &= ~o.words[i];
+        return *this;
+    };
+
+    unsigned count() const {
+        unsigned n = 0;
+        for (int i = 0; i < CHANSET_WORDS; i++) n += __builtin_popcount(words[i]);
+        return n;
+    };
+    bool empty() const {
+        uint32_t any = 0;
+        for (int i = 0; i < CHANSET_WORDS; i++) any |= words[i];
+        return any == 0;
+    };
+
+    /*
+        Walks the set channels in ascending order. Empty words are skipped
+        whole and each set bit costs one count-trailing-zeros.
+    */
+    class iterator {
+        public:
+        iterator(const uint32_t *words, int word) : _words(words), _word(word), _bits(0) {
+            if (_word < CHANSET_WORDS) {
+                _bits = _words[_word];
+                advance();
+            }
+        };
+        unsigned operator*() const {return (_word << 5) + __builtin_ctz(_bits) + 1;};
+        iterator &operator++() {
+            _bits &= _bits - 1;
+            advance();
+            return *this;
+        };
+        bool operator!=(const iterator &o) const {return _word != o._word || _bits != o._bits;};
+
+        private:
+        void advance() {
+            while (_bits == 0 && ++_word < CHANSET_WORDS)
+                _bits = _words[_word];
+            if (_bits == 0)
+                _word = CHANSET_WORDS;
+        };
+        const uint32_t *_words;
+        int _word;
+        uint32_t _bits;
+    };
+    iterator begin() const {return iterator(words, 0);};
+    iterator end() const {return iterator(words, CHANSET_WORDS);};
+
+    uint32_t words[CHANSET_WORDS];
+
+    private:
+    void range(unsigned first, unsigned last, bool value) {
+        if (first > last) {
+            unsigned t = first;
+            first = last;
+            last = t;
+        }
+        if (first < 1)
+            first = 1;
+        if (last > CHANSET_CHANNELS)
+            last = CHANSET_CHANNELS;
+        if (first > last)
+            return;
+        unsigned lo = first - 1, hi = last - 1;
+        unsigned wlo = lo >> 5, whi = hi >> 5;
+        uint32_t mlo = 0xFFFFFFFFu << (lo & 31);
+        uint32_t mhi = 0xFFFFFFFFu >> (31 - (hi & 31));
+        if (wlo == whi)
+            mlo &= mhi;
+        for (unsigned w = wlo; w <= whi; w++) {
+            uint32_t mask = w == wlo ? mlo : w == whi ? mhi : 0xFFFFFFFFu;
+            if (value)
+                words[w] |= mask;
+            else
+                words[w] &= ~mask;
+        }
+    };
+};
+
+#endif // _chan_set_h_
@@ -0,0 +1,133 @@
+#ifndef _cues_h_
+#define _cues_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "looks.h"
+
+// Flash after the 4KB EEPROM sector at 0x101F0000 up to the end of the
+// 2MB flash. The program image must stay below CUE_REGION_START
+#define CUE_REGION_START 0x101F1000u
+#define CUE_REGION_END 0x10200000u
+#define CUE_SECTOR_BYTES 4096
+#define CUE_SECTORS ((CUE_REGION_END - CUE_REGION_START) / CUE_SECTOR_BYTES)
+#define CUE_MAX_NUMBER 999
+#define CUE_MAX_CUES 512        // held in the RAM index, 4 bytes each
+
+// Marks a live record; a superseded record has its magic programmed to 0
+#define CUE_MAGIC 0xC0E1
+// A record still being written, dead until its magic is programmed down to CUE_MAGIC
+#define CUE_PENDING 0xF0E1
+
+struct CueHeader {
+    uint16_t magic;
+    uint16_t number;
+    uint16_t length;    // bytes of look following the header (looks.h)
+    uint16_t reserved;
+
+    const uint8_t *look() const {return (const uint8_t *)(this + 1);};
+};
+
+#define CUE_MAX_LOOK (CUE_SECTOR_BYTES - sizeof(CueHeader))
+
+/*
+    Numbered looks kept in flash, encoded as runs of lit channels
+    (looks.h). Records are read in place through XIP, so recalling a cue
+    walks its runs straight out of flash with no copy.
+
+    Where each live cue sits is kept in a RAM index sorted by number,
+    and how full each sector is in a table beside it, both rebuilt from
+    flash when the store is made; finding a cue is a binary search and
+    nothing but record and compaction walks the flash.
+
+    Records are appended within a sector and never span two; recording
+    a number again appends a new record and clears the old one's magic,
+    which flash can do without an erase. One sector is always kept
+    erased: when no sector has room, the one with the most superseded
+    records has its live records copied into the erased sector and is
+    then erased itself, so no more than a page is ever held in RAM.
+
+    Erasing and programming stall the whole chip for tens of
+    milliseconds with interrupts off, DMX output included, so only
+    record and remove write to flash. Recall never does. A record is
+    written pending and only made live once the one it replaces is
+    superseded, so a failed write leaves the old cue or none, never
+    two or a torn one. Each operation
+    runs through flash_safe_execute(), which parks the other core first
+    so nothing fetches from XIP while flash is busy; call them from a
+    task, not an interrupt.
+*/
+class CueStore {
+    public:
+    enum return_code {
+        SUCCESS = 0,
+
+        // No sector has room, even after compacting, or CUE_MAX_CUES
+        // cues are already recorded
+        ERR_FULL = -1,
+
+        // The look encodes to more than CUE_MAX_LOOK bytes
+        ERR_TOO_BIG = -2,
+
+        // The number is outside 1..CUE_MAX_NUMBER
+        ERR_BAD_NUMBER = -3,
+
+        // No cue has that number
+        ERR_NOT_FOUND = -4,
+
+        // The other core could not be parked to write flash; the store
+        // is reloaded and holds what was written before
+        ERR_FLASH = -5
+    };
+
+    CueStore(uintptr_t start = CUE_REGION_START, size_t sectors = CUE_SECTORS);
+
+    /*
+        Stores every non-zero channel of frames[universe][1..512] as cue
+        number. frames entries may be null for universes not in use.
+    */
+    return_code record(uint16_t number, const uint8_t *const frames[LOOK_UNIVERSES]);
+    return_code remove(uint16_t number);
+
+    // The live record of a cue in flash, nullptr if it is not recorded
+    const CueHeader *find(uint16_t number) const;
+    // Lowest recorded number above after, 0 if there is none
+    uint16_t next(uint16_t after) const;
+    // Writes up to max recorded numbers in ascending order, returns how many
+    size_t list(uint16_t *numbers, size_t max) const;
+    size_t count() const {return _count;};
+
+    private:
+    struct usage {
+        uint16_t used;      // bytes from the start of the sector to the first free byte
+        uint16_t dead;      // bytes of superseded records
+    };
+
+    const uint8_t *sector(size_t s) const {return (const uint8_t *)(_start + s * CUE_SECTOR_BYTES);};
+    const CueHeader *at(size_t i) const {return (const CueHeader *)(_start + _offsets[i]);};
+    void load();
+    usage scan(size_t s) const;
+    size_t search(uint16_t number) const;
+    void indexAt(uint16_t number, uintptr_t address);
+    void write(uintptr_t address, const void *data, size_t length);
+    void erase(size_t s);
+    return_code settle(return_code status);
+    void kill(size_t i);
+    void supersede(const CueHeader *cue);
+    bool compact();
+    uintptr_t room(size_t bytes);
+
+    uintptr_t _start;
+    size_t _sectors;
+    bool _failed;           // a flash operation failed, later ones are skipped until settle()
+    bool _copies;           // load() found a number live twice, left by a compaction that failed
+    usage _usage[CUE_SECTORS];
+    // The index: live cue numbers in ascending order and the byte offset
+    // of each record from _start
+    uint16_t _numbers[CUE_MAX_CUES];
+    uint16_t _offsets[CUE_MAX_CUES];
+    size_t _count;
+};
+
+#endif // _cues_h_
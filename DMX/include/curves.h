@@ -0,0 +1,97 @@
+#ifndef _curves_h_
+#define _curves_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// User defined curves, loaded at run time
+#define CURVE_CUSTOM_COUNT 2
+
+/*
+    Dimmer curves map a channel's level to the level sent on the wire.
+    The built in curves are 256 entry tables generated at compile time,
+    so applying a curve is one table lookup per slot.
+
+    Curves belong to output slots: they are applied as a frame is sent,
+    after the patch has moved keypad channels to their output
+    addresses, so a curve on slot n follows whatever is patched to n.
+*/
+enum dimmer_curve : uint8_t {
+    CURVE_LINEAR = 0,
+    // Square law, for fixtures that are too bright low down
+    CURVE_SQUARE,
+    // Inverse square (square root), for fixtures that are too dim low down
+    CURVE_INV_SQUARE,
+    // Smoothstep, slow at both ends for incandescent style fades
+    CURVE_SCURVE,
+    CURVE_CUSTOM,
+    CURVE_COUNT = CURVE_CUSTOM + CURVE_CUSTOM_COUNT
+};
+
+struct CurveLut {
+    uint8_t level[256];
+};
+
+constexpr uint32_t curve_isqrt(uint32_t x) {
+    uint32_t r = 0;
+    while ((r + 1) * (r + 1) <= x)
+        r++;
+    return r;
+}
+
+constexpr uint8_t curve_point(dimmer_curve curve, uint32_t x) {
+    switch (curve) {
+    case CURVE_SQUARE:
+        return (x * x + 127) / 255;
+    case CURVE_INV_SQUARE:
+        return curve_isqrt(x * 255);
+    case CURVE_SCURVE:
+        return (x * x * (3 * 255 - 2 * x) + 255 * 255 / 2) / (255 * 255);
+    default:
+        return x;
+    }
+}
+
+constexpr CurveLut make_curve(dimmer_curve curve) {
+    CurveLut lut = {};
+    for (uint32_t x = 0; x < 256; x++)
+        lut.level[x] = curve_point(curve, x);
+    return lut;
+}
+
+inline constexpr CurveLut curve_linear = make_curve(CURVE_LINEAR);
+inline constexpr CurveLut curve_square = make_curve(CURVE_SQUARE);
+inline constexpr CurveLut curve_inv_square = make_curve(CURVE_INV_SQUARE);
+inline constexpr CurveLut curve_scurve = make_curve(CURVE_SCURVE);
+
+static_assert(curve_square.level[255] == 255 && curve_square.level[128] == 64, "square curve");
+static_assert(curve_inv_square.level[255] == 255 && curve_inv_square.level[64] == 127, "inverse square curve");
+static_assert(curve_scurve.level[255] == 255 && curve_scurve.level[128] == 128, "s-curve");
+
+/*
+    round(level * scale / 255) with a multiply and shifts, exact for all
+    8 bit inputs, so scale 255 passes the level through unchanged.
+*/
+static inline uint8_t scale8(uint8_t level, uint8_t scale) {
+    uint32_t t = (uint32_t)level * scale + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+/*
+    One pass over a frame: out[i] = luts[curve[i]].level[in[i]] for
+    i < length. Index 0 is the start code and should be linear.
+*/
+static inline void curve_apply(const CurveLut *luts, const uint8_t *curve, const uint8_t *in,
+                               uint8_t *out, size_t length) {
+    for (size_t i = 0; i < length; i++)
+        out[i] = luts[curve[i]].level[in[i]];
+}
+
+// As curve_apply, with each level first scaled by scale[i] (255 is full)
+static inline void curve_apply_scaled(const CurveLut *luts, const uint8_t *curve, const uint8_t *scale,
+                                      const uint8_t *in, uint8_t *out, size_t length) {
+    for (size_t i = 0; i < length; i++)
+        out[i] = luts[curve[i]].level[scale8(in[i], scale[i])];
+}
+
+#endif // _curves_h_
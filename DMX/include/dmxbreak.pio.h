@@ -0,0 +1,40 @@
+// -------------------------------------------------- //
+// This file is autogenerated by pioasm; do not edit! //
+// -------------------------------------------------- //
+
+#pragma once
+
+#if !PICO_NO_HARDWARE
+#include "hardware/pio.h"
+#endif
+
+// -------- //
+// DmxBreak //
+// -------- //
+
+#define DmxBreak_wrap_target 0
+#define DmxBreak_wrap 4
+
+static const uint16_t DmxBreak_program_instructions[] = {
+            //     .wrap_target
+    0xe031, //  0: set    x, 17                      
+    0x00c0, //  1: jmp    pin, 0                     
+    0x0141, //  2: jmp    x--, 1                 [1] 
+    0xc010, //  3: irq    nowait 0 rel               
+    0x20a0, //  4: wait   1 pin, 0                   
+            //     .wrap
+};
+
+#if !PICO_NO_HARDWARE
+static const struct pio_program DmxBreak_program = {
+    .instructions = DmxBreak_program_instructions,
+    .length = 5,
+    .origin = -1,
+};
+
+static inline pio_sm_config DmxBreak_program_get_default_config(uint offset) {
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_wrap(&c, offset + DmxBreak_wrap_target, offset + DmxBreak_wrap);
+    return c;
+}
+#endif
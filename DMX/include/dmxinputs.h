@@ -0,0 +1,80 @@
+#ifndef _dmx_inputs_h_
+#define _dmx_inputs_h_
+
+#include <stdint.h>
+
+#include "DmxInput.h"
+#include "mailbox.h"
+
+#define DMX_MAX_INPUTS 2                // as PATCH_MAX_INPUTS, each takes a state machine and a DMA channel
+
+/*
+    One received DMX frame, start code at 0. Slots past the end of a
+    short frame read as 0.
+*/
+struct DmxInputFrame {
+    uint8_t levels[DMX_UNIVERSE_SIZE + 1];
+};
+
+/*
+    Receives DMX on up to DMX_MAX_INPUTS pins with the vendored
+    DmxInput. Each input's DMA fills a buffer that is only stable in the
+    DMA interrupt, so there the frame is copied once into a mailbox and
+    the reader woken; frames with a start code other than 0 are not
+    levels and are skipped. An input that stops receiving keeps its
+    last frame.
+
+    DmxInput itself only finishes a frame once all 512 slots are in, so
+    each input also gets a DmxBreak state machine on the same pin. When
+    it sees the next BREAK (54us low) before the frame is full, the
+    slots received so far are handed over as a short frame and the
+    receiver is pointed at the MARK AFTER BREAK. Senders that trim
+    their frames, this firmware's own output among them, need it. An
+    input left without a detector, for want of a state machine or
+    program memory, only ever delivers full frames: a shorter one stalls
+    until 512 slots worth of the next frames have come in, and
+    detecting() says so.
+*/
+class DmxInputs {
+    public:
+    // Called from the DMA interrupt when a frame is published to an empty mailbox
+    typedef void (*notify_fn)(void *arg);
+
+    DmxInputs();
+
+    // Starts receiving on pin, from pio0 if it has room and pio1 otherwise
+    DmxInput::return_code begin(unsigned input, unsigned pin, notify_fn notify, void *arg);
+
+    /*
+        The newest frame of an input, start code at 0, or nullptr if
+        none arrived since the last call. Stays valid until the next
+        call that returns a frame.
+    */
+    const uint8_t *latest(unsigned input);
+    bool active(unsigned input) const {return input < DMX_MAX_INPUTS && _frames[input] != nullptr;};
+    // Frames taken from an input, levels and otherwise
+    uint32_t received(unsigned input) const {return input < DMX_MAX_INPUTS ? _received[input] : 0;};
+    // Of those, frames ended by a BREAK before slot 512
+    uint32_t shortFrames(unsigned input) const {return input < DMX_MAX_INPUTS ? _short[input] : 0;};
+    // Whether short frames are delivered, see above
+    bool detecting(unsigned input) const {return active(input) && _breakSm[input] >= 0;};
+
+    private:
+    static void frameDone(DmxInput *instance);
+    static void breakSeen();
+    void take(unsigned input, unsigned length);
+    void watch(unsigned input, unsigned pin);
+
+    DmxInput _inputs[DMX_MAX_INPUTS];
+    volatile uint8_t _buffers[DMX_MAX_INPUTS][DMX_UNIVERSE_SIZE + 1];   // written by DMA
+    Mailbox<DmxInputFrame> *_frames[DMX_MAX_INPUTS];
+    volatile uint32_t _received[DMX_MAX_INPUTS];
+    volatile uint32_t _short[DMX_MAX_INPUTS];
+    int _breakSm[DMX_MAX_INPUTS];       // DmxBreak state machine on the input's PIO, or -1
+    static int _breakOffset[2];         // DmxBreak program per PIO, or -1
+    notify_fn _notify;
+    void *_arg;
+    static DmxInputs *_self;            // the DmxInput callback carries no user data
+};
+
+#endif // _dmx_inputs_h_
@@ -0,0 +1,97 @@
+#ifndef _dmx_parallel_h_
+#define _dmx_parallel_h_
+
+#include "DmxOutput.h"
+#include "bitslice.h"
+
+#define DMXPAR_MAX_UNIVERSES BITSLICE_LANES
+
+/*
+    Sends up to 8 universes on consecutive pins from a single PIO state
+    machine and a single DMA channel. Frames are transposed into the
+    bit-sliced layout of bitslice.h and clocked out together, so all
+    universes share one break and stay in exact lockstep.
+
+    Every universe in the group is sent with the same length (the
+    longest one); shorter universes are padded with zeros.
+*/
+class DmxParallel
+{
+public:
+    /*
+        Called from the refresh alarm interrupt at the start of every
+        frame in continuous mode. Fills universes[0..count) and *length
+        (start code included) and returns true if any universe changed
+        since the previous call. Unchanged frames are resent without
+        being transposed again.
+    */
+    typedef bool (*frame_callback)(DmxParallel *instance, const uint8_t *universes[DMXPAR_MAX_UNIVERSES],
+                                   uint *length, void *user_data);
+
+    /*
+        Called from the DMA interrupt once the whole frame has been
+        handed to the state machine, as DmxOutput::done_callback.
+    */
+    typedef void (*done_callback)(DmxParallel *instance, void *user_data);
+
+private:
+    uint _prgm_offset;
+    uint _first_pin;
+    uint _count;
+    uint _sm;
+    PIO _pio;
+    uint _dma;
+    uint32_t *_sliced = nullptr;
+    uint _sliced_length = 0;
+
+    int _alarm = -1;
+    uint32_t _period_us;
+    uint64_t _next_frame_us;
+    frame_callback _frame_cb;
+    void *_frame_user_data;
+
+    done_callback _done_cb = nullptr;
+    void *_done_user_data;
+
+    static void dma_irq_handler();
+    static void refresh_alarm_handler(uint alarm_num);
+    void start_frame();
+
+public:
+    /*
+        Starts the group on pins first_pin .. first_pin + count - 1.
+        The DmxParallel program must already be loaded at prgm_offset.
+    */
+    DmxOutput::return_code begin(uint first_pin, uint count, uint prgm_offset, PIO pio = pio0);
+
+    /*
+        Transpose and send one frame. universes holds count pointers
+        (null sends zeros), length is the number of bytes per universe
+        including the start code. Must not be called while busy().
+    */
+    void write_dmx(const uint8_t *const universes[], uint length);
+
+    /*
+        Resend the last transposed frame unchanged.
+    */
+    void repeat_dmx();
+
+    /*
+        Hardware paced output, as DmxOutput::start_continuous. The group
+        uses its own alarm so it does not share timing with single outputs.
+    */
+    DmxOutput::return_code start_continuous(uint refresh_hz, frame_callback frame_cb, void *user_data = nullptr);
+    void set_refresh_rate(uint refresh_hz);
+    void stop_continuous();
+    bool continuous() {return _alarm >= 0;};
+
+    bool busy();
+    void on_frame_done(done_callback done_cb, void *user_data = nullptr);
+    uint count() {return _count;};
+    uint first_pin() {return _first_pin;};
+    // Bytes per universe of the last frame sent, start code included
+    uint length() {return _sliced_length;};
+    void end();
+};
+
+#endif // _dmx_parallel_h_
@@ -0,0 +1,45 @@
+// -------------------------------------------------- //
+// This file is autogenerated by pioasm; do not edit! //
+// -------------------------------------------------- //
+
+#pragma once
+
+#if !PICO_NO_HARDWARE
+#include "hardware/pio.h"
+#endif
+
+// ----------- //
+// DmxParallel //
+// ----------- //
+
+#define DmxParallel_wrap_target 4
+#define DmxParallel_wrap 9
+
+static const uint16_t DmxParallel_program_instructions[] = {
+    0xa003, //  0: mov    pins, null                 
+    0xe036, //  1: set    x, 22                      
+    0x0342, //  2: jmp    x--, 2                 [3] 
+    0xa70b, //  3: mov    pins, ~null            [7] 
+            //     .wrap_target
+    0x80e0, //  4: pull   ifempty block              
+    0xa203, //  5: mov    pins, null             [2] 
+    0xe047, //  6: set    y, 7                       
+    0x6208, //  7: out    pins, 8                [2] 
+    0x0087, //  8: jmp    y--, 7                     
+    0xa60b, //  9: mov    pins, ~null            [6] 
+            //     .wrap
+};
+
+#if !PICO_NO_HARDWARE
+static const struct pio_program DmxParallel_program = {
+    .instructions = DmxParallel_program_instructions,
+    .length = 10,
+    .origin = -1,
+};
+
+static inline pio_sm_config DmxParallel_program_get_default_config(uint offset) {
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_wrap(&c, offset + DmxParallel_wrap_target, offset + DmxParallel_wrap);
+    return c;
+}
+#endif
@@ -0,0 +1,163 @@
+#ifndef _effects_h_
+#define _effects_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chanset.h"
+
+#define EFFECT_MAX_SLOTS 64
+#define EFFECT_MAX_UNIVERSES 8
+#define EFFECT_CHANNELS 512
+#define EFFECT_DEFAULT_PERIOD_MS 1000
+
+enum effect_wave : uint8_t {
+    EFFECT_NONE = 0,
+    // One channel of the selection at a time, stepping first to last
+    EFFECT_CHASE,
+    EFFECT_SINE,
+    EFFECT_TRIANGLE,
+    EFFECT_SQUARE,
+    // Each channel jumps to a random level once per period
+    EFFECT_FLICKER,
+    // Not a wave: asks for the effects on some channels to be stopped
+    EFFECT_STOP
+};
+
+/*
+    One cycle of a periodic wave in 256 steps, 0 to 255 and back, so
+    the 8 high bits of a 32 bit phase index it directly.
+*/
+struct WaveLut {
+    uint8_t level[256];
+};
+
+// cos(2 pi i / 256) by Taylor series; only ever run by the compiler
+constexpr double wave_cos(uint32_t i) {
+    const double pi = 3.14159265358979323846;
+    int k = i < 128 ? (int)i : (int)i - 256;
+    double x = 2 * pi * k / 256.0;
+    double term = 1;
+    double sum = 1;
+    for (int n = 1; n < 16; n++) {
+        term *= -x * x / ((2 * n - 1) * (2 * n));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr uint8_t wave_point(effect_wave wave, uint32_t i) {
+    switch (wave) {
+    case EFFECT_SINE:
+        return (1 - wave_cos(i)) * 127.5 + 0.5 >= 255 ? 255 : (uint8_t)((1 - wave_cos(i)) * 127.5 + 0.5);
+    case EFFECT_TRIANGLE:
+        return i < 128 ? i * 255 / 127 : (255 - i) * 255 / 127;
+    case EFFECT_SQUARE:
+        return i < 128 ? 255 : 0;
+    default:
+        return 0;
+    }
+}
+
+constexpr WaveLut make_wave(effect_wave wave) {
+    WaveLut lut = {};
+    for (uint32_t i = 0; i < 256; i++)
+        lut.level[i] = wave_point(wave, i);
+    return lut;
+}
+
+inline constexpr WaveLut wave_sine = make_wave(EFFECT_SINE);
+inline constexpr WaveLut wave_triangle = make_wave(EFFECT_TRIANGLE);
+inline constexpr WaveLut wave_square = make_wave(EFFECT_SQUARE);
+
+static_assert(wave_sine.level[0] == 0 && wave_sine.level[128] == 255 && wave_sine.level[64] == 128, "sine wave");
+static_assert(wave_triangle.level[0] == 0 && wave_triangle.level[127] == 255 && wave_triangle.level[255] == 0,
+              "triangle wave");
+
+/*
+    Chases and waves running over ranges of channels. Each effect holds
+    one slot of a fixed pool, kept packed like FadeEngine's, and a 32
+    bit phase that advances by a per millisecond rate, so one cycle
+    takes the effect's period whatever the frame rate.
+
+    Channels are offset in phase by an equal share of the cycle across
+    the range the effect was started on, so a wave rolls along the
+    selection and a chase lights one channel at a time. Waveforms come
+    from the compile time tables above, scaled to the effect's level;
+    there is no floating point at run time.
+*/
+class EffectEngine {
+    public:
+    enum return_code {
+        SUCCESS = 0,
+
+        // Every slot already runs an effect
+        ERR_NO_SLOT = -1,
+
+        // The universe or channel range is out of range
+        ERR_BAD_CHANNEL = -2,
+
+        // The wave is EFFECT_NONE, EFFECT_STOP or unknown
+        ERR_BAD_WAVE = -3
+    };
+
+    EffectEngine();
+
+    /*
+        Run a wave on channels first .. last of a universe, peaking at
+        level, one cycle per period_ms (0 for EFFECT_DEFAULT_PERIOD_MS).
+        Effects already on any of those channels are stopped there.
+        Returns ERR_NO_SLOT, changing nothing, if no slot is left for it.
+    */
+    return_code start(uint8_t universe, uint16_t first, uint16_t last, effect_wave wave, uint8_t level,
+                      uint32_t period_ms);
+
+    /*
+        Stop every effect on channels first .. last, leaving them at the
+        level they last reached. An effect that only partly overlaps
+        keeps running on the rest of its channels, in the same phase.
+        Returns ERR_NO_SLOT, changing nothing, if that needs a slot for
+        the channels above the range and none is free.
+    */
+    return_code stop(uint8_t universe, uint16_t first, uint16_t last);
+
+    /*
+        Advance every effect by elapsed_ms and write the new levels to
+        frames[universe][channel] (frames hold the start code at 0).
+        Only channels whose level changed are written, and marked in
+        *dirty[universe] if dirty is given. frames entries may be null
+        for universes that are not written.
+    */
+    void step(uint32_t elapsed_ms, uint8_t *const frames[EFFECT_MAX_UNIVERSES],
+              ChannelSet *const dirty[EFFECT_MAX_UNIVERSES] = nullptr);
+
+    size_t active() const {return _count;};
+    // Bit u is set while universe u has an effect running
+    uint32_t universes() const {return _universes;};
+
+    private:
+    struct slot {
+        uint32_t phase;         // of the origin channel, a full cycle is 2^32
+        uint32_t rate;          // phase per millisecond
+        uint32_t spacing;       // phase between neighbouring channels
+        uint16_t first;
+        uint16_t last;
+        uint16_t origin;        // first channel of the range it was started on
+        uint8_t universe;
+        uint8_t wave;
+        uint8_t level;
+        bool fresh;             // not stepped yet, every channel must be written
+    };
+
+    return_code claim(const slot &s);
+    void release(size_t i);
+    uint32_t random();
+
+    slot _slots[EFFECT_MAX_SLOTS];
+    size_t _count;
+    uint32_t _universes;
+    uint16_t _perUniverse[EFFECT_MAX_UNIVERSES];
+    uint32_t _seed;
+};
+
+#endif // _effects_h_
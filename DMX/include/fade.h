@@ -0,0 +1,86 @@
+#ifndef _fade_h_
+#define _fade_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chanset.h"
+
+#define FADE_MAX_SLOTS 512
+#define FADE_MAX_UNIVERSES 8
+#define FADE_CHANNELS 512
+
+/*
+    Timed level changes for individual channels. Every fading channel
+    holds one slot from a fixed pool; slots are kept packed at the front
+    of the pool so a step only ever touches the fades that are running.
+
+    Levels are 16.16 fixed point and advance by a per millisecond step
+    computed once when the fade starts, so stepping is one multiply and
+    one add per fade with no division (the Cortex-M0+ has no FPU).
+    Fades are time based rather than frame based, so a fade takes the
+    same time whatever the frame rate of its universe.
+*/
+class FadeEngine {
+    public:
+    enum return_code {
+        SUCCESS = 0,
+
+        // Every slot is already fading a channel
+        ERR_NO_SLOT = -1,
+
+        // The universe or channel is out of range
+        ERR_BAD_CHANNEL = -2
+    };
+
+    FadeEngine();
+
+    /*
+        Fade a channel from its current level to target over time_ms.
+        A channel that is already fading is retargeted from where it is.
+        A time of 0 cancels any fade and leaves the level to the caller.
+    */
+    return_code start(uint8_t universe, uint16_t channel, uint8_t current, uint8_t target, uint32_t time_ms);
+
+    /*
+        Stop fading channels first .. first + count - 1, leaving them at
+        the level they last reached. Used when a level is set directly.
+    */
+    void cancel(uint8_t universe, uint16_t first, uint16_t count);
+
+    /*
+        Advance every fade by elapsed_ms and write the new levels to
+        frames[universe][channel] (frames hold the start code at 0).
+        Finished fades land exactly on their target and free their slot.
+        frames entries may be null for universes that are not written.
+        If dirty is given, every channel written is also marked in
+        *dirty[universe].
+    */
+    void step(uint32_t elapsed_ms, uint8_t *const frames[FADE_MAX_UNIVERSES],
+              ChannelSet *const dirty[FADE_MAX_UNIVERSES] = nullptr);
+
+    size_t active() const {return _count;};
+    // Bit u is set while universe u has a fade running
+    uint32_t universes() const {return _universes;};
+
+    private:
+    struct slot {
+        int32_t level;          // 16.16
+        int32_t step;           // 16.16 per millisecond
+        uint32_t remaining;     // milliseconds
+        uint16_t channel;
+        uint8_t universe;
+        uint8_t target;
+    };
+
+    void release(size_t i);
+
+    slot _slots[FADE_MAX_SLOTS];
+    size_t _count;
+    uint32_t _universes;
+    uint16_t _perUniverse[FADE_MAX_UNIVERSES];
+    // Slot index + 1 of the fade on each channel, 0 if it is not fading
+    uint16_t _index[FADE_MAX_UNIVERSES][FADE_CHANNELS + 1];
+};
+
+#endif // _fade_h_
@@ -0,0 +1,87 @@
+#ifndef _layers_h_
+#define _layers_h_
+
+#include "chanset.h"
+
+#define LAYER_CHANNELS CHANSET_CHANNELS
+
+/*
+    The level sources of one universe, stacked from base to parked.
+    Each layer holds a level for the channels it owns; a channel's
+    output starts at 0 and every layer that owns it is combined in
+    order, either replacing the level so far (LTP) or taking the higher
+    of the two (HTP). Parked channels are on top and always win.
+
+    Every change marks the channel dirty in its layer, and compose()
+    recomputes only channels that are dirty in some layer, so a frame
+    costs the channels changed times the layers rather than the whole
+    universe.
+*/
+class LayerStack {
+    public:
+    enum layer : uint8_t {
+        // Recalled presets and cues
+        LAYER_BASE = 0,
+        // Keypad levels and fades
+        LAYER_MANUAL,
+        // Chases, waves and flicker
+        LAYER_EFFECTS,
+        // sACN and Art-Net input
+        LAYER_NETWORK,
+        // Channels held at a fixed level regardless of everything else
+        LAYER_PARKED,
+        LAYER_COUNT
+    };
+
+    enum merge : uint8_t {
+        // Latest takes precedence: the layer replaces what is below it
+        MERGE_LTP = 0,
+        // Highest takes precedence: the higher of the layer and below
+        MERGE_HTP
+    };
+
+    /*
+        Base, manual and parked are LTP; effects and network are HTP so
+        they can only add light on top of the manual levels.
+    */
+    LayerStack();
+
+    void setMode(layer l, merge mode);
+    merge mode(layer l) const {return _mode[l];};
+
+    // Own channels first .. first + count - 1 at level
+    void fill(layer l, unsigned first, unsigned count, uint8_t level);
+    void set(layer l, unsigned channel, uint8_t level) {fill(l, channel, 1, level);};
+    // Own channels first .. first + count - 1 at levels[0 .. count - 1],
+    // marking dirty only those whose level or ownership changes
+    void load(layer l, unsigned first, const uint8_t *levels, unsigned count);
+    // Give up channels so the layers below show through
+    void release(layer l, unsigned first, unsigned count);
+    void releaseAll(layer l);
+
+    uint8_t level(layer l, unsigned channel) const {return _levels[l][channel];};
+    const ChannelSet &owned(layer l) const {return _owned[l];};
+
+    /*
+        Direct access for writers that update many channels at once (fades,
+        network input). levels(l)[channel] may only be written for owned
+        channels, and each write must be marked in dirty(l).
+    */
+    uint8_t *levels(layer l) {return _levels[l];};
+    ChannelSet &dirty(layer l) {return _dirty[l];};
+
+    /*
+        Recompute every dirty channel into frame[1..512] and clear the
+        dirty marks. Returns false, leaving frame untouched, if nothing
+        was dirty.
+    */
+    bool compose(uint8_t *frame);
+
+    private:
+    uint8_t _levels[LAYER_COUNT][LAYER_CHANNELS + 1];
+    ChannelSet _owned[LAYER_COUNT];
+    ChannelSet _dirty[LAYER_COUNT];
+    merge _mode[LAYER_COUNT];
+};
+
+#endif // _layers_h_
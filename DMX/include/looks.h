@@ -0,0 +1,74 @@
+#ifndef _looks_h_
+#define _looks_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOOK_UNIVERSES 8
+#define LOOK_CHANNELS 512
+#define LOOK_RUN_MAX 255        // levels in one run
+// Zero channels a run may carry rather than ending; a new run costs a
+// 4 byte header, so shorter gaps are cheaper to store as levels
+#define LOOK_GAP 4
+
+/*
+    A run of neighbouring channels of one universe, followed by count
+    levels and a pad byte if count is odd, so the next run stays 2 byte
+    aligned and can be read in place from flash.
+*/
+struct LookRun {
+    uint16_t first;
+    uint8_t universe;
+    uint8_t count;
+
+    const uint8_t *levels() const {return (const uint8_t *)(this + 1);};
+    size_t bytes() const {return sizeof(LookRun) + ((count + 1u) & ~1u);};
+};
+
+// Where look_encode() carries on from, start at the default
+struct LookCursor {
+    uint16_t channel = 1;
+    uint8_t universe = 0;
+};
+
+/*
+    Encodes the non-zero channels of frames[universe][1..512] (frames
+    entries may be null) as runs. Lit fixtures are mostly neighbouring
+    channels, so a look costs about a byte per lit channel plus a few
+    per fixture, rather than 513 bytes per universe.
+
+    Writes whole runs to out from at until the next run would pass max
+    bytes, moves at past them and returns the bytes written, 0 once the
+    look is done. out may be null to only count.
+*/
+size_t look_encode(const uint8_t *const frames[LOOK_UNIVERSES], LookCursor &at, uint8_t *out, size_t max);
+
+// Bytes the whole look encodes to
+size_t look_size(const uint8_t *const frames[LOOK_UNIVERSES]);
+
+/*
+    Copies each run of an encoded look into frames[universe], one
+    memcpy per run. Channels between runs are left as they are, so
+    clear the frames first for the look alone.
+*/
+void look_decode(const uint8_t *look, size_t length, uint8_t *const frames[LOOK_UNIVERSES]);
+
+/*
+    Steps through the runs of an encoded look, nullptr after the last.
+    Runs that do not fit a universe are skipped.
+*/
+static inline const LookRun *look_next(const uint8_t *&at, const uint8_t *end) {
+    while (at + sizeof(LookRun) <= end) {
+        const LookRun *run = (const LookRun *)at;
+        at += run->bytes();
+        if (at > end)
+            break;
+        if (run->universe < LOOK_UNIVERSES && run->first >= 1 && run->count > 0 &&
+            run->first + run->count - 1 <= LOOK_CHANNELS)
+            return run;
+    }
+    at = end;
+    return nullptr;
+}
+
+#endif // _looks_h_
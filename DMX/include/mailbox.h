@@ -0,0 +1,96 @@
+#ifndef _mailbox_h_
+#define _mailbox_h_
+
+#include <stdint.h>
+
+#include "hardware/sync.h"
+
+/*
+    Latest-wins handoff of whole frames from one writer to one reader,
+    built as a triple buffer. The writer fills its own slot in place and
+    publishes it by swapping it with the middle slot; the reader takes
+    the newest frame by swapping the middle slot with its own. Neither
+    side ever waits for the other or copies a frame, and a frame that is
+    published before the previous one was read simply replaces it.
+
+    The swaps are a few instructions under a hardware spin lock, as the
+    Cortex-M0+ has no atomic exchange and the two sides may run on
+    different cores.
+*/
+template <typename T>
+class Mailbox {
+    public:
+    // Takes one of the striped locks; the 8 claimable ones go to the DMX universes
+    Mailbox() : lock(spin_lock_instance(next_striped_spin_lock_num())) {};
+    // Shares a lock with other mailboxes, so they can change hands all together
+    explicit Mailbox(spin_lock_t *shared) : lock(shared) {};
+    Mailbox(const Mailbox &) = delete;
+    Mailbox &operator=(const Mailbox &) = delete;
+
+    /*
+        The writer's slot. Its contents are whatever was published two
+        frames ago, so the writer must fill in every field it relies on.
+    */
+    T *writeSlot() {return &slots[writer];};
+
+    /*
+        Hands the writer's slot to the reader. Returns true if an unread
+        frame was superseded.
+    */
+    bool publish() {
+        uint32_t save = spin_lock_blocking(lock);
+        bool dropped = publishLocked();
+        spin_unlock(lock, save);
+        return dropped;
+    };
+
+    /*
+        The newest published frame, or nullptr if nothing was published
+        since the last call. Stays valid until the next call.
+    */
+    T *latest() {
+        uint32_t save = spin_lock_blocking(lock);
+        T *frame = latestLocked();
+        spin_unlock(lock, save);
+        return frame;
+    };
+
+    /*
+        As publish() and latest() for a caller already holding spinLock(),
+        so that mailboxes sharing one lock change hands all together.
+    */
+    bool publishLocked() {
+        uint8_t published = writer;
+        writer = middle;
+        middle = published;
+        bool dropped = fresh;
+        fresh = true;
+        if (dropped)
+            superseded++;
+        return dropped;
+    };
+    T *latestLocked() {
+        if (!fresh)
+            return nullptr;
+        uint8_t read = reader;
+        reader = middle;
+        middle = read;
+        fresh = false;
+        return &slots[reader];
+    };
+    spin_lock_t *spinLock() const {return lock;};
+
+    // Frames replaced before the reader got to them
+    uint32_t dropped() const {return superseded;};
+
+    private:
+    T slots[3];
+    uint8_t writer = 0;
+    uint8_t middle = 1;
+    uint8_t reader = 2;
+    bool fresh = false;
+    uint32_t superseded = 0;
+    spin_lock_t *lock;
+};
+
+#endif // _mailbox_h_
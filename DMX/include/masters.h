@@ -0,0 +1,72 @@
+#ifndef _masters_h_
+#define _masters_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chanset.h"
+#include "curves.h"
+
+#define MASTER_SUBMASTERS 8
+#define MASTER_UNIVERSES 8
+#define MASTER_FULL 255
+
+/*
+    A grandmaster that scales every channel and submasters that each
+    scale the channels in their own mask. A channel under several
+    submasters is scaled by each of them in turn.
+
+    Masters do not touch the frames. A fader move rebuilds a per channel
+    scale table for each universe it affects, once, and the table is
+    applied to the levels as they are sent (see DMX::setScale). The
+    scaling is a multiply and shifts per channel (scale8), with no
+    division.
+
+    Like curves, the masks are over output slots, not keypad channels:
+    the scale is applied as a frame is sent, after the patch has moved
+    each keypad channel to its output address. A submaster holding slot
+    n dims whatever is patched to n.
+*/
+class MasterBank {
+    public:
+    enum return_code {
+        SUCCESS = 0,
+
+        // The submaster number is not below MASTER_SUBMASTERS
+        ERR_BAD_MASTER = -1,
+
+        // The universe or channel range is out of range
+        ERR_BAD_CHANNEL = -2
+    };
+
+    MasterBank();
+
+    void setGrand(uint8_t level);
+    return_code setLevel(unsigned sub, uint8_t level);
+    // Adds output slots first .. last of a universe (0 based) to a submaster
+    return_code assign(unsigned sub, unsigned universe, unsigned first, unsigned last);
+    // Empties the mask of a submaster
+    return_code clear(unsigned sub);
+
+    uint8_t grand() const {return _grand;};
+    uint8_t level(unsigned sub) const {return sub < MASTER_SUBMASTERS ? _level[sub] : 0;};
+    const ChannelSet &mask(unsigned sub, unsigned universe) const {return _mask[sub][universe];};
+    // Bit u is set while universe u's scale table is out of date
+    uint32_t stale() const {return _stale;};
+
+    /*
+        Writes the scale of every slot of a universe to scale[0 .. 512],
+        start code at 0 and always full, and marks the universe current.
+        Returns false if every channel is at full, when the table can be
+        dropped altogether.
+    */
+    bool build(unsigned universe, uint8_t scale[CHANSET_CHANNELS + 1]);
+
+    private:
+    uint8_t _grand;
+    uint8_t _level[MASTER_SUBMASTERS];
+    ChannelSet _mask[MASTER_SUBMASTERS][MASTER_UNIVERSES];
+    uint32_t _stale;
+};
+
+#endif // _masters_h_
@@ -0,0 +1,85 @@
+#ifndef _merge_h_
+#define _merge_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chanset.h"
+
+#define MERGE_MAX_SOURCES 4
+#define MERGE_CHANNELS 512
+#define MERGE_WORDS (MERGE_CHANNELS / 4)
+
+/*
+    Merges whole frames from several independent sources (network
+    controllers, a DMX input) into one universe. Each channel is merged
+    either HTP, the highest level of every active source, or LTP, the
+    level of the source that changed that channel most recently.
+
+    Frames are stored four channels to a word and merged with SWAR
+    kernels: an HTP merge is a per-byte maximum and an LTP merge selects
+    bytes by an owner byte per channel, so a merge of every source is a
+    handful of word operations per four channels with no per-channel
+    branches. Words past the last channel any source sends are skipped.
+
+    main.cpp merges the sACN and Art-Net frames of each universe with
+    one before they reach the network layer.
+*/
+class SourceMerge {
+    public:
+    enum return_code {
+        SUCCESS = 0,
+
+        // The source number is not below MERGE_MAX_SOURCES
+        ERR_BAD_SOURCE = -1
+    };
+
+    SourceMerge();
+
+    /*
+        Replace the frame of a source and stamp it with now_ms. levels[0]
+        is channel 1; channels past count are 0. Channels whose level
+        differs from the source's previous frame become owned by it for
+        LTP.
+    */
+    return_code update(unsigned source, const uint8_t *levels, unsigned count, uint32_t now_ms);
+
+    /*
+        Forget a source. The LTP channels it owned pass to the remaining
+        source with the newest frame.
+    */
+    void drop(unsigned source);
+
+    // Drop every source whose last frame is older than timeout_ms
+    void expire(uint32_t now_ms, uint32_t timeout_ms);
+
+    // Channels are HTP until set LTP
+    void setLTP(unsigned first, unsigned last, bool ltp);
+
+    /*
+        Recompute the output from every active source. Returns true if
+        any channel changed and, if changed is given, marks each one.
+    */
+    bool merge(ChannelSet *changed = nullptr);
+
+    uint8_t level(unsigned channel) const {return output()[channel - 1];};
+    // Merged levels, channel n at [n - 1]
+    const uint8_t *output() const {return (const uint8_t *)_out;};
+    bool active(unsigned source) const {return source < MERGE_MAX_SOURCES && (_active & (1u << source));};
+    uint32_t sources() const {return _active;};
+    uint32_t stamp(unsigned source) const {return source < MERGE_MAX_SOURCES ? _stamp[source] : 0;};
+    // Channels up to the last one any active source sends
+    unsigned count() const;
+
+    private:
+    uint32_t _levels[MERGE_MAX_SOURCES][MERGE_WORDS];
+    uint32_t _owner[MERGE_WORDS];       // LTP source of each channel, one byte per channel
+    uint32_t _out[MERGE_WORDS];
+    uint32_t _stamp[MERGE_MAX_SOURCES];
+    uint16_t _count[MERGE_MAX_SOURCES];     // channels each source sends
+    uint16_t _merged;                   // count() at the last merge, the output past it is 0
+    uint32_t _active;
+    ChannelSet _ltp;
+};
+
+#endif // _merge_h_
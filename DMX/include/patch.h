@@ -0,0 +1,109 @@
+#ifndef _patch_h_
+#define _patch_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PATCH_MAX_UNIVERSES 8
+#define PATCH_MAX_INPUTS 2              // DMX inputs, see dmxinputs.h
+#define PATCH_MAX_SOURCES (PATCH_MAX_UNIVERSES + PATCH_MAX_INPUTS)
+// Source number of DMX input n (0 based), after the keypad universes
+#define PATCH_INPUT(n) (PATCH_MAX_UNIVERSES + (n))
+#define PATCH_CHANNELS 512
+#define PATCH_MAX_RUNS 256
+
+/*
+    count logical channels from src_first of logical universe
+    src_universe, sent on the same number of consecutive addresses from
+    dst_first of output universe dst_universe. Universes are 0 based.
+    A src_universe of PATCH_INPUT(n), made by PatchTable::route(), takes
+    the channels from DMX input n instead, so the table is a routing
+    matrix from every source to every output.
+*/
+struct PatchRun {
+    uint16_t src_first;
+    uint16_t dst_first;
+    uint16_t count;
+    uint8_t src_universe;
+    uint8_t dst_universe;
+};
+
+/*
+    A patch compiled for output: runs grouped by source, with
+    runs that continue each other merged, so building the patched frames
+    is one memcpy per run and never a per channel lookup. Produced by
+    PatchTable::compile.
+*/
+class PatchMap {
+    public:
+    PatchMap() : _count(0) {};
+
+    /*
+        Copy every run whose source is in sources (bit per source) from
+        logical[source] to outputs[universe]. Both hold the start code at
+        0; entries of either may be null to skip them.
+        An address patched from two logical channels shows whichever of
+        them was scattered last, so such patches are best avoided.
+    */
+    void scatter(uint32_t sources, const uint8_t *const logical[PATCH_MAX_SOURCES],
+                 uint8_t *const outputs[PATCH_MAX_UNIVERSES]) const;
+
+    // Output universes written by the sources in sources
+    uint32_t targets(uint32_t sources) const;
+    size_t size() const {return _count;};
+
+    private:
+    friend class PatchTable;
+
+    PatchRun _runs[PATCH_MAX_RUNS];
+    uint16_t _count;
+    uint16_t _begin[PATCH_MAX_SOURCES + 1];     // runs of source u are _begin[u] .. _begin[u + 1] - 1
+    uint8_t _targets[PATCH_MAX_SOURCES];
+};
+
+/*
+    The editable patch: logical channels, as numbered on the keypad, and
+    channels of the DMX inputs, to DMX addresses. A channel may be
+    patched to any number of addresses; a channel that is not patched is
+    not sent.
+*/
+class PatchTable {
+    public:
+    enum return_code {
+        SUCCESS = 0,
+
+        // The table already holds PATCH_MAX_RUNS runs
+        ERR_FULL = -1,
+
+        // A universe or channel range is out of range
+        ERR_BAD_CHANNEL = -2
+    };
+
+    PatchTable() : _count(0) {};
+
+    // Keypad channels of src_universe, below PATCH_MAX_UNIVERSES
+    return_code add(uint8_t src_universe, uint16_t src_first, uint16_t count, uint8_t dst_universe,
+                    uint16_t dst_first);
+    // Channels of DMX input input, below PATCH_MAX_INPUTS
+    return_code route(uint8_t input, uint16_t src_first, uint16_t count, uint8_t dst_universe,
+                      uint16_t dst_first);
+    void clear() {_count = 0;};
+    // Every channel of universes 0 .. universes - 1 to the same address
+    void identity(unsigned universes);
+
+    size_t size() const {return _count;};
+    const PatchRun &operator[](size_t i) const {return _runs[i];};
+    // Highest address patched on an output universe, 0 if none
+    uint16_t highest(unsigned universe) const;
+
+    void compile(PatchMap &map) const;
+
+    private:
+    return_code append(uint8_t source, uint16_t src_first, uint16_t count, uint8_t dst_universe,
+                       uint16_t dst_first);
+
+    PatchRun _runs[PATCH_MAX_RUNS];
+    size_t _count;
+};
+
+#endif // _patch_h_
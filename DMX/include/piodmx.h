@@ -3,39 +3,230 @@
 
 #include "DmxOutput.h"
 #include "DmxOutput.pio.h"
+#include "curves.h"
+#include "dmxparallel.h"
+#include "hardware/sync.h"
+
+// Upper bound on the refresh rate. Frames are never started closer together
+// than their own length, so a full universe still runs at about 44Hz
+#define DMX_DEFAULT_REFRESH_HZ 250
+// Shortest frame sent in adaptive mode, in slots after the start code
+#define DMX_DEFAULT_MIN_SLOTS 24
+// Frames a shrinking universe keeps its old length for, so the zeros that
+// allowed it to shrink reach the fixtures before those slots stop being sent
+#define DMX_SHRINK_HOLDOFF_FRAMES 4
+// One universe per PIO state machine, pio0 and pio1 have four each
+#define DMX_MAX_UNIVERSES 8
+// Task notification index await() sleeps on, index 0 belongs to stream buffers
+#define DMX_NOTIFY_INDEX 1
+
+struct tskTaskControlBlock;
+
+/*
+    A run of channels set to one level, the unit of sparse updates.
+*/
+struct DmxSpan {
+    uint16_t first;     // first channel, 1..512
+    uint16_t count;
+    uint8_t universe;   // 0 based
+    uint8_t level;
+    uint16_t time;      // fade time in tenths of a second, 0 to snap
+    uint8_t effect;     // 0 for levels, else the effect_wave to run (effects.h), time its period
+};
+// Span time that gives the channels back instead of setting a level
+#define DMX_SPAN_RELEASE 0xFFFF
+// Span times for cue spans, first holds the cue number and count is 0.
+// Recalling cue 0 goes to the next cue (cues.h)
+#define DMX_SPAN_RECORD 0xFFFE
+#define DMX_SPAN_RECALL 0xFFFD
+// Span times that step the keypad history back or forward (undo.h), and
+// that close the history step of the spans queued before it
+#define DMX_SPAN_UNDO 0xFFFC
+#define DMX_SPAN_REDO 0xFFFB
+#define DMX_SPAN_COMMIT 0xFFFA
 
 class DMX {
     public:
-    DMX(PIO pio = pio0);
+    /*
+        Called from the DMA interrupt at the end of every frame of a
+        universe, once its buffer is no longer read. Keep it short; it
+        may compose the next frame with setChannel() or writeBuffer().
+    */
+    typedef void (*frame_hook)(uint universe, void *user_data);
+
+    DMX();
     ~DMX();
-    void begin(int pinp/*, int pinn*/);
-    void sendDMX();
-    void setChannel(int channel, int value);
-    void writeBuffer(uint8_t *buffer, bool noStartCode = true);
-    void unasfeSetChannel(int channel, int value);
-    void unsafeWriteBuffer(uint8_t *buffer, bool noStartCode = true);
-    bool busy();
-    void forceBusy(bool busy) {this->data_update = busy;};
-    uint getprgm_offsetp() {return dmxp->getprgm_offset();};
-    void getshadowbuff(uint8_t *buffer) {for (int i = 1; i < 513; i++) buffer[i] = dmxData[i];};
-    //uint getprgm_offsetn() {return dmxn->getprgm_offset();};
-    DmxOutput::return_code _pstatus;
-    //DmxOutput::return_code _nstatus;
+    /*
+        Starts the output port for a universe (0 based) on a pin. State
+        machines are taken from pio0 first and then from pio1, and the
+        PIO program is loaded once per PIO block.
+    */
+    DmxOutput::return_code begin(uint universe, uint pin, bool inverted = false);
+    /*
+        Starts count universes from first_universe as one parallel group
+        on pins first_pin .. first_pin + count - 1, sharing a single state
+        machine and DMA channel (see DmxParallel). Group members are sent,
+        paced and checked for busy together; per universe calls act on
+        the whole group. Only one group is supported.
+    */
+    DmxOutput::return_code beginParallel(uint first_universe, uint count, uint first_pin);
+    void sendDMX(uint universe);
+    /*
+        Sends the next frame of every universe in the mask (bit 0 for
+        universe 0). All frames are made ready before the first is
+        started, then each port is started with interrupts off, so the
+        breaks begin within microseconds of each other. The ports must
+        have finished their last frame, see await().
+    */
+    void sendTogether(uint32_t universes);
+    DmxOutput::return_code startRefresh(uint universe, uint refresh_hz = DMX_DEFAULT_REFRESH_HZ);
+    // Changes the rate of a universe already started with startRefresh(), false otherwise
+    bool setRefreshRate(uint universe, uint refresh_hz);
+    void stopRefresh(uint universe);
+    /*
+        Frames are shortened to the highest non-zero or patched slot,
+        never below the minimum and never above the maximum length.
+        Setting minimum and maximum to the same value fixes the length.
+    */
+    void setLength(uint universe, uint slots);
+    void setMinLength(uint universe, uint slots);
+    void setPatchedLength(uint universe, uint slots);
+    void setChannel(uint universe, int channel, int value);
+    void writeBuffer(uint universe, uint8_t *buffer, bool noStartCode = true);
+    /*
+        Applies, in order, every span that belongs to this universe as
+        one frame update. The cost scales with the channels changed
+        rather than the universe size. Fade times are ignored and
+        effect spans are skipped.
+    */
+    void writeSpans(uint universe, const DmxSpan *spans, size_t count);
+    /*
+        In place access to the next frame of a universe (start code at 0)
+        for a writer that changes scattered channels in several passes.
+        The frame holds the latest levels and is not swapped in until
+        commitFrame(); every beginFrame() must be followed by one.
+    */
+    uint8_t *beginFrame(uint universe);
+    void commitFrame(uint universe);
+    bool busy(uint universe);
+    /*
+        Blocks the calling task until the frame on the wire has been sent,
+        sleeping on a task notification from the DMA interrupt instead of
+        polling. Only one task may wait on a universe at a time. Returns
+        false if the frame did not finish within timeout_ms.
+    */
+    bool await(uint universe, uint32_t timeout_ms);
+    void onFrame(uint universe, frame_hook hook, void *user_data = nullptr);
+    void getshadowbuff(uint universe, uint8_t *buffer);
+    /*
+        Dimmer curves are applied to the levels as they are sent, so
+        frames, getshadowbuff() and fades all work on uncurved levels.
+        A universe pays nothing for curves until one of its channels is
+        given a curve other than CURVE_LINEAR; after that each new frame
+        costs one table lookup per slot sent. Channels here are output
+        slots, after any patch. Setting a curve or scale waits for a
+        frame being shaped with the tables it replaces.
+    */
+    void setCurve(uint universe, uint first, uint last, dimmer_curve curve);
+    dimmer_curve getCurve(uint universe, uint channel);
+    // Loads custom curve index (0 based) from a 256 entry table
+    bool setCustomCurve(uint index, const uint8_t lut[256]);
+    /*
+        Scales every slot of a universe as it is sent, scale[n] for slot
+        n out of 255 (see MasterBank::build). The table is copied; null
+        removes the scaling. Scaling comes before the dimmer curve.
+    */
+    void setScale(uint universe, const uint8_t *scale);
+
+    bool active(uint universe) {return universe < DMX_MAX_UNIVERSES && ports[universe] != nullptr;};
+    uint universes() {return universeCount;};
+    uint getPin(uint universe) {return active(universe) ? ports[universe]->pin : 0;};
+    uint getLength(uint universe) {return active(universe) ? ports[universe]->maxSlots : 0;};
+    uint getMinLength(uint universe) {return active(universe) ? ports[universe]->minSlots : 0;};
+    // Frames per second while refreshed continuously, 0 while frames are sent on demand
+    uint getRefreshRate(uint universe) {return active(universe) ? ports[universe]->refresh_hz : 0;};
+    // Slots currently sent after the start code
+    uint getFrameLength(uint universe) {return active(universe) ? ports[universe]->universeSize - 1 : 0;};
+    uint getFrameRate(uint universe);
+    DmxOutput::return_code status(uint universe) {return active(universe) ? ports[universe]->status : DmxOutput::ERR_NO_SM_AVAILABLE;};
 
 
     private:
-    uint8_t dmxData[513];
-    //uint8_t ndmxData[513];
-    uint universeSize = 513;
-    uint pinp;
-    //uint pinn;
-    PIO _pio;
-    bool data_update = false;
-
-
-    protected:
-    DmxOutput *dmxp;
-    //DmxOutput *dmxn;
+    /*
+        Each universe's frames are double buffered. The output path only
+        ever reads the front buffer and writers only ever touch the back
+        buffer. A completed back buffer is promoted by swapping the two
+        pointers at the start of the next frame, so a frame on the wire
+        never mixes old and new levels and neither side waits for the other.
+    */
+    /*
+        Curves and scale are double buffered the same way: setters edit
+        the copy the output is not reading and swap it in under
+        swap_lock, then wait for any frame still being shaped with the
+        old copy, so the next edit is never read half done.
+    */
+    struct Shaping {
+        uint8_t curve[DMX_UNIVERSE_SIZE + 1];   // curve of each slot, the start code linear
+        uint8_t scale[DMX_UNIVERSE_SIZE + 1];   // out of 255, while scaled
+        bool scaled;
+    };
+    struct Universe {
+        DmxOutput output;
+        uint8_t dmxData[2][513];
+        uint8_t *volatile front;
+        uint8_t *back;
+        volatile bool back_ready = false;   // back holds a complete frame that has not been sent
+        volatile bool back_stale = false;   // back is one swap behind front and must be resynced
+        spin_lock_t *swap_lock;
+        volatile uint universeSize = DMX_DEFAULT_MIN_SLOTS + 1;   // bytes sent this frame, start code included
+        volatile uint maxSlots = DMX_UNIVERSE_SIZE;
+        volatile uint minSlots = DMX_DEFAULT_MIN_SLOTS;
+        volatile uint patchedSlots = 0;
+        volatile uint back_highest = 0;     // highest non-zero slot of back
+        uint front_highest = 0;             // highest non-zero slot of front
+        uint shrink_holdoff = 0;
+        uint pin;
+        uint number;                        // universe index, passed to hook
+        uint refresh_hz = 0;
+        bool parallel = false;              // sent by the parallel group instead of output
+        volatile bool sending = false;      // DMA has not finished the current frame
+        tskTaskControlBlock *volatile waiter = nullptr;
+        frame_hook hook = nullptr;
+        void *hook_data = nullptr;
+        const Shaping *volatile shape = nullptr;    // one of shapes, null while all are linear and unscaled
+        Shaping *shapes = nullptr;          // the live shaping and the one being edited
+        uint8_t *curved = nullptr;          // front with scale and curves applied, sent instead of front
+        uint curved_size = 0;               // bytes of curved that are current
+        volatile bool recurve = false;      // curves changed, curved must be rebuilt
+        volatile bool shaping = false;      // nextFrame() is reading shape and the curve tables
+        DmxOutput::return_code status;
+
+        ~Universe() {delete[] shapes; delete[] curved;};
+
+        uint8_t *beginWrite();
+        void commitWrite(int highest = -1);
+        uint8_t *nextFrame(bool *swapped = nullptr);
+        void updateLength();
+    };
+    static uint8_t *frameSource(DmxOutput *output, uint *length, void *user_data);
+    static bool groupSource(DmxParallel *group, const uint8_t *universes[DMXPAR_MAX_UNIVERSES],
+                            uint *length, void *user_data);
+    static void frameDone(DmxOutput *output, void *user_data);
+    static void groupDone(DmxParallel *group, void *user_data);
+    static void finishFrame(Universe *u, long *woken);
+    static Shaping *editShaping(Universe *u);
+    static void publishShaping(Universe *u, const Shaping *next);
+    static void settle(Universe *u);
+    Universe *newUniverse(uint universe, uint pin);
+    void freeUniverse(Universe *u);
+    bool loadProgram(int p, const pio_program *program, int *offsets);
+
+    Universe *ports[DMX_MAX_UNIVERSES];
+    uint universeCount = 0;
+    int prgm_offset[2] = {-1, -1};
+    DmxParallel *group = nullptr;
+    uint groupFirst = 0;
+    int group_offset[2] = {-1, -1};
 };
 
-#endif // _pio_dmx_h_
\ No newline at end of file
+#endif // _pio_dmx_h_
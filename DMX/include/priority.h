@@ -0,0 +1,102 @@
+#ifndef _priority_h_
+#define _priority_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PRIORITY_MAX_SOURCES 4          // a primary and a backup console with room to spare
+#define PRIORITY_CHANNELS 512
+#define PRIORITY_CID_SIZE 16
+#define PRIORITY_MAX 200                // highest universe or per-address priority
+#define PRIORITY_NONE 0xFF              // no source holds the channel
+
+/*
+    Merges the sources sending one universe by priority, as E1.31 asks
+    of a receiver: each channel takes the level of the source with the
+    highest priority for it, and the highest level among sources tied
+    on priority. A source's priority for a channel is its per-address
+    priority (start code 0xDD) while it sends them, where 0 means it
+    does not drive the channel, otherwise its universe priority; a
+    source never drives channels past the last level it sent.
+
+    Sources are kept in a table of PRIORITY_MAX_SOURCES entries keyed by
+    their CID. Each packet is compared with what the source sent last
+    and only the channels whose level or priority moved are arbitrated
+    again. Most of those settle against the current winner alone; only
+    a channel whose winner lost ground looks at the other sources.
+*/
+class PriorityMerge {
+    public:
+    enum return_code {
+        SUCCESS = 0,
+
+        // Every entry of the source table is taken
+        ERR_FULL = -1
+    };
+
+    PriorityMerge();
+
+    /*
+        The entry of the source with this CID, taking a free one for a
+        new source. Returns ERR_FULL if there is none; fresh is set when
+        the entry was taken by this call.
+    */
+    int claim(const uint8_t *cid, bool *fresh);
+
+    // Levels from a start code 0 packet, levels[0] is channel 1
+    void levels(unsigned source, const uint8_t *levels, unsigned count, uint8_t priority, uint32_t now_ms);
+
+    // Per-address priorities from a start code 0xDD packet, priorities[0] is channel 1
+    void priorities(unsigned source, const uint8_t *priorities, unsigned count, uint32_t now_ms);
+
+    // Forget a source, its channels pass to whoever is next in line
+    void drop(unsigned source);
+
+    /*
+        Drop every source silent for more than timeout_ms, and fall back
+        to the universe priority of any that stopped sending per-address
+        priorities for as long.
+    */
+    void expire(uint32_t now_ms, uint32_t timeout_ms);
+
+    // Merged levels, channel n at [n - 1]
+    const uint8_t *output() const {return _out;};
+    // Channels up to the last one any source sends
+    unsigned count() const {return _count;};
+    // Highest universe priority among the sources
+    uint8_t priority() const;
+    unsigned sources() const;
+    bool active(unsigned source) const {return source < PRIORITY_MAX_SOURCES && _sources[source].active;};
+
+    // Whether the output changed since the last call
+    bool changed();
+    // Channels arbitrated again by the last packet or drop
+    unsigned cost() const {return _cost;};
+
+    private:
+    struct Source {
+        uint8_t cid[PRIORITY_CID_SIZE];
+        uint32_t stamp;                 // last packet of either kind
+        uint32_t addressStamp;          // last per-address priorities
+        uint16_t count;                 // levels sent
+        uint8_t priority;               // universe priority
+        bool active;
+        bool perAddress;
+        uint8_t levels[PRIORITY_CHANNELS];
+        uint8_t address[PRIORITY_CHANNELS];     // per-address priorities, as sent
+    };
+
+    void settle(unsigned source, unsigned c, uint8_t after);
+    void rescan(unsigned c);
+    void recount();
+
+    Source _sources[PRIORITY_MAX_SOURCES];
+    uint8_t _out[PRIORITY_CHANNELS];
+    uint8_t _rank[PRIORITY_CHANNELS];   // priority of the winner plus one, 0 if no source drives the channel
+    uint8_t _winner[PRIORITY_CHANNELS]; // source of each level in _out, or PRIORITY_NONE
+    uint16_t _count;
+    uint16_t _cost;
+    bool _changed;
+};
+
+#endif // _priority_h_
@@ -0,0 +1,81 @@
+#ifndef _undo_h_
+#define _undo_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define UNDO_DELTAS 1024        // 4 bytes each
+#define UNDO_STEPS 64           // commands kept, 8 bytes each
+
+/*
+    What one command did to one channel: its level before and after,
+    and whether it was owned (captured) before and after, so a release
+    can be undone too.
+*/
+struct UndoDelta {
+    uint16_t where;     // channel in bits 0-9, universe in 10-12, owned before in 13, after in 14
+    uint8_t before;
+    uint8_t after;
+
+    unsigned channel() const {return where & 0x3FF;};
+    unsigned universe() const {return (where >> 10) & 0x7;};
+    bool ownedBefore() const {return where & (1u << 13);};
+    bool ownedAfter() const {return where & (1u << 14);};
+};
+
+/*
+    Undo and redo history of keypad commands, kept as the channels each
+    command changed rather than as frames, in a fixed ring of
+    UNDO_DELTAS deltas, so a command that sets a handful of channels
+    costs a handful of deltas and the memory used never grows.
+
+    Deltas are recorded as a command is applied and commit() closes the
+    step. When the ring fills, the oldest steps are dropped; a single
+    command too large for the ring clears the whole history instead,
+    since the steps before it could no longer be undone in order.
+    Recording after an undo drops the steps that could have been redone.
+*/
+class UndoRing {
+    public:
+    UndoRing();
+
+    void record(uint8_t universe, uint16_t channel, bool ownedBefore, uint8_t before, bool ownedAfter,
+                uint8_t after);
+    // Closes the step being recorded, if anything was recorded
+    void commit();
+
+    /*
+        Step back or forward one command. Returns how many deltas the
+        step has, 0 if there is nothing to undo or redo; delta(i) then
+        gives them in the order to apply, newest first for undo.
+    */
+    size_t undo();
+    size_t redo();
+    const UndoDelta &delta(size_t i) const;
+
+    // Commands that can be undone and redone
+    size_t undoable() const {return _done - _oldest;};
+    size_t redoable() const {return _newest - _done;};
+
+    private:
+    struct step {
+        uint32_t start;     // delta counters, the ring index is the counter modulo UNDO_DELTAS
+        uint32_t end;
+    };
+
+    step &at(uint32_t s) {return _steps[s % UNDO_STEPS];};
+
+    UndoDelta _deltas[UNDO_DELTAS];
+    step _steps[UNDO_STEPS];
+    uint32_t _floor;        // oldest delta kept
+    uint32_t _open;         // first delta of the step being recorded
+    uint32_t _write;        // next delta
+    uint32_t _oldest;       // step counters: [_oldest, _done) can be undone,
+    uint32_t _done;         // [_done, _newest) redone
+    uint32_t _newest;
+    step _applying;         // the step undo() or redo() last returned
+    bool _reverse;
+    bool _overflow;         // the open step outgrew the ring
+};
+
+#endif // _undo_h_
@@ -0,0 +1,328 @@
+#include "cues.h"
+
+#include "hardware/flash.h"
+#include "pico/flash.h"
+
+#include <string.h>
+
+#define CUE_ERASED 0xFFFF
+#define CUE_FLASH_TIMEOUT_MS 100    // for the other core to park before and resume after an operation
+
+/*
+    One erase or program, run by flash_safe_execute() with the other
+    core parked and interrupts off.
+*/
+struct FlashJob {
+    uintptr_t offset;       // from the start of flash
+    const uint8_t *data;    // nullptr erases
+    size_t length;
+};
+
+static void flashJob(void *param) {
+    const FlashJob *job = (const FlashJob *)param;
+    if (job->data != nullptr)
+        flash_range_program(job->offset, job->data, job->length);
+    else
+        flash_range_erase(job->offset, job->length);
+}
+
+static_assert(CUE_SECTORS * CUE_SECTOR_BYTES <= 0x10000, "record offsets are 16 bit");
+static_assert((CUE_PENDING & CUE_MAGIC) == CUE_MAGIC && CUE_PENDING != CUE_ERASED,
+              "committing a record only clears bits");
+
+CueStore::CueStore(uintptr_t start, size_t sectors) : _start(start), _sectors(sectors), _failed(false), _copies(false), _count(0) {
+    if (_sectors > CUE_SECTORS)
+        _sectors = CUE_SECTORS;
+    load();
+}
+
+/**
+ * @brief Steps through the records of a sector
+ * @param offset Where to look, advanced past the record returned
+ * @return The record at offset, live or superseded, nullptr at the end of the sector
+ */
+static const CueHeader *nextRecord(const uint8_t *sector, size_t &offset) {
+    if (offset + sizeof(CueHeader) > CUE_SECTOR_BYTES)
+        return nullptr;
+    const CueHeader *cue = (const CueHeader *)(sector + offset);
+    if (cue->magic == CUE_ERASED)
+        return nullptr;
+    size_t bytes = sizeof(CueHeader) + cue->length;
+    if (offset + bytes > CUE_SECTOR_BYTES || (cue->length & 1)) {
+        // Not a record this store wrote; treat the rest of the sector as used
+        offset = CUE_SECTOR_BYTES;
+        return nullptr;
+    }
+    offset += bytes;
+    return cue;
+}
+
+/**
+ * @brief Rebuilds the index and the sector usage from flash
+ * @post If a failed compaction left two live copies of a record, the first found is used
+ *       and kill() supersedes both
+ */
+void CueStore::load() {
+    _count = 0;
+    _copies = false;
+    for (size_t s = 0; s < _sectors; s++) {
+        _usage[s] = scan(s);
+        size_t offset = 0;
+        while (const CueHeader *cue = nextRecord(sector(s), offset)) {
+            if (cue->magic != CUE_MAGIC)
+                continue;
+            size_t i = search(cue->number);
+            if (i >= _count || _numbers[i] != cue->number)
+                indexAt(cue->number, (uintptr_t)cue);
+            else
+                _copies = true;
+        }
+    }
+}
+
+CueStore::usage CueStore::scan(size_t s) const {
+    size_t used = 0;
+    size_t dead = 0;
+    size_t last = 0;
+    while (const CueHeader *cue = nextRecord(sector(s), used)) {
+        if (cue->magic != CUE_MAGIC)
+            dead += used - last;
+        last = used;
+    }
+    dead += used - last;            // anything unreadable is reclaimed with the dead records
+    return {(uint16_t)used, (uint16_t)dead};
+}
+
+/**
+ * @brief Binary search of the index
+ * @return Position of the first indexed number not below number
+ */
+size_t CueStore::search(uint16_t number) const {
+    size_t low = 0;
+    size_t high = _count;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (_numbers[mid] < number)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+/**
+ * @brief Points the index entry of number at address, adding the entry if needed
+ */
+void CueStore::indexAt(uint16_t number, uintptr_t address) {
+    size_t i = search(number);
+    if (i >= _count || _numbers[i] != number) {
+        if (_count >= CUE_MAX_CUES)
+            return;
+        memmove(_numbers + i + 1, _numbers + i, (_count - i) * sizeof(_numbers[0]));
+        memmove(_offsets + i + 1, _offsets + i, (_count - i) * sizeof(_offsets[0]));
+        _numbers[i] = number;
+        _count++;
+    }
+    _offsets[i] = address - _start;
+}
+
+/**
+ * @brief Programs bytes anywhere in the region
+ * @pre The bytes written are erased, or only have bits cleared
+ * @post Each page touched is read back from flash, merged and reprogrammed,
+ *       so neighbouring records in the same page are kept
+ */
+void CueStore::write(uintptr_t address, const void *data, size_t length) {
+    static uint8_t page[FLASH_PAGE_SIZE];
+    const uint8_t *from = (const uint8_t *)data;
+    while (length > 0) {
+        uintptr_t base = address & ~(uintptr_t)(FLASH_PAGE_SIZE - 1);
+        size_t at = address - base;
+        size_t n = FLASH_PAGE_SIZE - at < length ? FLASH_PAGE_SIZE - at : length;
+        memcpy(page, (const void *)base, FLASH_PAGE_SIZE);
+        memcpy(page + at, from, n);
+        FlashJob job = {base - XIP_BASE, page, FLASH_PAGE_SIZE};
+        if (_failed || flash_safe_execute(flashJob, &job, CUE_FLASH_TIMEOUT_MS) != PICO_OK) {
+            _failed = true;
+            return;
+        }
+        address += n;
+        from += n;
+        length -= n;
+    }
+}
+
+void CueStore::erase(size_t s) {
+    FlashJob job = {(uintptr_t)sector(s) - XIP_BASE, nullptr, CUE_SECTOR_BYTES};
+    if (_failed || flash_safe_execute(flashJob, &job, CUE_FLASH_TIMEOUT_MS) != PICO_OK) {
+        _failed = true;
+        return;
+    }
+    _usage[s] = {0, 0};
+}
+
+/**
+ * @brief Ends a record or remove
+ * @return status, or ERR_FLASH if a flash operation failed on the way
+ * @post After a failure the index and usage are rebuilt from what reached flash,
+ *       as after a power cut
+ */
+CueStore::return_code CueStore::settle(return_code status) {
+    if (!_failed)
+        return status;
+    _failed = false;
+    load();
+    return ERR_FLASH;
+}
+
+/**
+ * @brief Supersedes the record of index entry i and drops the entry
+ */
+void CueStore::kill(size_t i) {
+    uint16_t number = _numbers[i];
+    supersede(at(i));
+    _count--;
+    memmove(_numbers + i, _numbers + i + 1, (_count - i) * sizeof(_numbers[0]));
+    memmove(_offsets + i, _offsets + i + 1, (_count - i) * sizeof(_offsets[0]));
+    if (!_copies)
+        return;
+    for (size_t s = 0; s < _sectors; s++) {
+        size_t offset = 0;
+        while (const CueHeader *cue = nextRecord(sector(s), offset)) {
+            if (cue->magic == CUE_MAGIC && cue->number == number)
+                supersede(cue);         // a copy the index does not point at
+        }
+    }
+}
+
+/**
+ * @brief Programs a record's magic to 0 and counts its bytes as reclaimable
+ */
+void CueStore::supersede(const CueHeader *cue) {
+    uint16_t dead = 0;
+    write((uintptr_t)&cue->magic, &dead, sizeof(dead));
+    _usage[((uintptr_t)cue - _start) / CUE_SECTOR_BYTES].dead += sizeof(CueHeader) + cue->length;
+}
+
+/**
+ * @brief Moves the live records of the sector with the most superseded
+ *        records into the spare sector and erases it, making it the spare
+ * @return false if there is no spare, nothing to reclaim or flash failed
+ */
+bool CueStore::compact() {
+    size_t spare = _sectors;
+    size_t worst = _sectors;
+    size_t mostDead = 0;
+    for (size_t s = 0; s < _sectors; s++) {
+        if (spare == _sectors && _usage[s].used == 0)
+            spare = s;
+        else if (_usage[s].dead > mostDead) {
+            mostDead = _usage[s].dead;
+            worst = s;
+        }
+    }
+    if (spare == _sectors || worst == _sectors)
+        return false;
+
+    uintptr_t to = (uintptr_t)sector(spare);
+    size_t offset = 0;
+    size_t last = 0;
+    while (const CueHeader *cue = nextRecord(sector(worst), offset)) {
+        if (cue->magic == CUE_MAGIC) {
+            write(to, cue, offset - last);
+            indexAt(cue->number, to);
+            to += offset - last;
+        }
+        last = offset;
+    }
+    _usage[spare] = {(uint16_t)(to - (uintptr_t)sector(spare)), 0};
+    erase(worst);
+    return !_failed;
+}
+
+/**
+ * @brief Finds bytes of free space for a record, compacting until there is
+ * @return The address to write the record at, 0 if the store is full
+ */
+uintptr_t CueStore::room(size_t bytes) {
+    while (true) {
+        size_t spares = 0;
+        size_t fresh = _sectors;
+        for (size_t s = 0; s < _sectors; s++) {
+            if (_usage[s].used != 0) {
+                // Fill sectors already in use before starting another
+                if (_usage[s].used + bytes <= CUE_SECTOR_BYTES)
+                    return (uintptr_t)sector(s) + _usage[s].used;
+            } else if (spares++ == 0) {
+                fresh = s;
+            }
+        }
+        // One erased sector is always left for compact()
+        if (spares > 1)
+            return (uintptr_t)sector(fresh);
+        if (!compact())
+            return 0;       // every record is live
+    }
+}
+
+CueStore::return_code CueStore::record(uint16_t number, const uint8_t *const frames[LOOK_UNIVERSES]) {
+    if (number < 1 || number > CUE_MAX_NUMBER)
+        return ERR_BAD_NUMBER;
+    size_t length = look_size(frames);
+    if (length > CUE_MAX_LOOK)
+        return ERR_TOO_BIG;
+    size_t i = search(number);
+    if ((i >= _count || _numbers[i] != number) && _count >= CUE_MAX_CUES)
+        return ERR_FULL;
+
+    uintptr_t address = room(sizeof(CueHeader) + length);
+    if (address == 0)
+        return settle(ERR_FULL);
+    CueHeader header = {CUE_PENDING, number, (uint16_t)length, 0};
+    write(address, &header, sizeof(header));
+
+    // Runs go out a batch at a time; a batch always holds the longest run
+    static uint8_t batch[2 * FLASH_PAGE_SIZE];
+    static_assert(sizeof(batch) >= sizeof(LookRun) + LOOK_RUN_MAX + 1, "a run must fit a batch");
+    LookCursor cursor;
+    uintptr_t to = address + sizeof(header);
+    while (size_t n = look_encode(frames, cursor, batch, sizeof(batch))) {
+        write(to, batch, n);
+        to += n;
+    }
+    _usage[(address - _start) / CUE_SECTOR_BYTES].used += sizeof(CueHeader) + length;
+
+    i = search(number);             // compaction may have moved the old record
+    if (i < _count && _numbers[i] == number)
+        kill(i);
+    uint16_t live = CUE_MAGIC;
+    write(address, &live, sizeof(live));
+    indexAt(number, address);
+    return settle(SUCCESS);
+}
+
+CueStore::return_code CueStore::remove(uint16_t number) {
+    size_t i = search(number);
+    if (i >= _count || _numbers[i] != number)
+        return ERR_NOT_FOUND;
+    kill(i);
+    return settle(SUCCESS);
+}
+
+const CueHeader *CueStore::find(uint16_t number) const {
+    size_t i = search(number);
+    return i < _count && _numbers[i] == number ? at(i) : nullptr;
+}
+
+uint16_t CueStore::next(uint16_t after) const {
+    if (after >= CUE_MAX_NUMBER)
+        return 0;
+    size_t i = search(after + 1);
+    return i < _count ? _numbers[i] : 0;
+}
+
+size_t CueStore::list(uint16_t *numbers, size_t max) const {
+    size_t n = _count < max ? _count : max;
+    memcpy(numbers, _numbers, n * sizeof(numbers[0]));
+    return n;
+}
@@ -0,0 +1,155 @@
+#include "dmxinputs.h"
+
+#include <string.h>
+
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+
+#include "DmxInput.pio.h"
+#include "dmxbreak.pio.h"
+
+// breakSeen() restarts the receiver at its wait for the MARK AFTER BREAK, just before its wrap target
+static_assert(DmxInput_wrap_target == 4, "DmxInput program no longer waits for the MARK AFTER BREAK at 3");
+
+DmxInputs *DmxInputs::_self = nullptr;
+int DmxInputs::_breakOffset[2] = {-1, -1};
+
+DmxInputs::DmxInputs() : _notify(nullptr), _arg(nullptr) {
+    memset(_frames, 0, sizeof(_frames));
+    for (unsigned i = 0; i < DMX_MAX_INPUTS; i++) {
+        _received[i] = 0;
+        _short[i] = 0;
+        _breakSm[i] = -1;
+    }
+}
+
+/**
+ * @brief Starts one input
+ * @param input Input number, 0 based
+ * @param pin GPIO the receiver drives
+ * @param notify Called from the DMA interrupt when a frame is waiting, may be nullptr
+ * @param arg Passed to notify
+ */
+DmxInput::return_code DmxInputs::begin(unsigned input, unsigned pin, notify_fn notify, void *arg) {
+    if (input >= DMX_MAX_INPUTS || _frames[input] != nullptr)
+        return DmxInput::ERR_NO_SM_AVAILABLE;
+    DmxInput::return_code status = _inputs[input].begin(pin, 0, DMX_UNIVERSE_SIZE, pio0);
+    if (status != DmxInput::SUCCESS)
+        status = _inputs[input].begin(pin, 0, DMX_UNIVERSE_SIZE, pio1);
+    if (status != DmxInput::SUCCESS)
+        return status;
+
+    _self = this;
+    _notify = notify;
+    _arg = arg;
+    _frames[input] = new Mailbox<DmxInputFrame>(spin_lock_instance(next_striped_spin_lock_num()));
+    _inputs[input].read_async(_buffers[input], frameDone);
+    watch(input, pin);
+    return DmxInput::SUCCESS;
+}
+
+/**
+ * @brief Starts a DmxBreak state machine beside an input's receiver
+ * @param input Input number, already receiving
+ * @param pin GPIO the receiver reads
+ * @post The input stays limited to full frames if its PIO has no room left
+ */
+void DmxInputs::watch(unsigned input, unsigned pin) {
+    PIO pio = _inputs[input]._pio;
+    uint p = pio_get_index(pio);
+    if (_breakOffset[p] < 0) {
+        if (!pio_can_add_program(pio, &DmxBreak_program))
+            return;
+        _breakOffset[p] = pio_add_program(pio, &DmxBreak_program);
+        uint irq = p ? PIO1_IRQ_0 : PIO0_IRQ_0;
+        irq_add_shared_handler(irq, breakSeen, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(irq, true);
+    }
+    int sm = pio_claim_unused_sm(pio, false);
+    if (sm < 0)
+        return;
+
+    pio_sm_config c = DmxBreak_program_get_default_config(_breakOffset[p]);
+    sm_config_set_in_pins(&c, pin);     // for WAIT
+    sm_config_set_jmp_pin(&c, pin);     // for JMP
+    sm_config_set_clkdiv(&c, clock_get_hz(clk_sys) / DMX_SM_FREQ);
+    pio_sm_init(pio, sm, _breakOffset[p], &c);
+
+    _breakSm[input] = sm;
+    pio_interrupt_clear(pio, sm);
+    pio_set_irq0_source_enabled(pio, (pio_interrupt_source)(pis_interrupt0 + sm), true);
+    pio_sm_set_enabled(pio, sm, true);
+}
+
+const uint8_t *DmxInputs::latest(unsigned input) {
+    if (!active(input))
+        return nullptr;
+    DmxInputFrame *frame = _frames[input]->latest();
+    return frame != nullptr ? frame->levels : nullptr;
+}
+
+/**
+ * @brief Takes a full frame from the DMA interrupt
+ */
+void DmxInputs::frameDone(DmxInput *instance) {
+    DmxInputs *self = _self;
+    unsigned input = instance - self->_inputs;
+    if (input >= DMX_MAX_INPUTS || self->_frames[input] == nullptr)
+        return;
+    self->take(input, DMX_UNIVERSE_SIZE + 1);
+}
+
+/**
+ * @brief Ends a short frame at the BREAK that follows it, from the PIO interrupt
+ * @note The BREAK is caught 54us in, leaving the rest of it and the MARK
+ *       AFTER BREAK to stop the DMA and restart the receiver
+ */
+void DmxInputs::breakSeen() {
+    DmxInputs *self = _self;
+    for (unsigned i = 0; i < DMX_MAX_INPUTS; i++) {
+        DmxInput &in = self->_inputs[i];
+        int sm = self->_breakSm[i];
+        if (sm < 0 || !pio_interrupt_get(in._pio, sm))
+            continue;
+        pio_interrupt_clear(in._pio, sm);
+        uint chan = in._dma_chan;
+        unsigned length = DMX_UNIVERSE_SIZE + 1 - dma_channel_hw_addr(chan)->transfer_count;
+        if (length == 0)
+            continue;                   // a full frame just ended and the receiver already waits for this BREAK
+
+        // RP2040-E13: an abort can raise the completion interrupt, which would re-arm the channel behind us
+        hw_clear_bits(&dma_hw->inte0, 1u << chan);
+        dma_channel_abort(chan);
+        dma_hw->ints0 = 1u << chan;
+        hw_set_bits(&dma_hw->inte0, 1u << chan);
+
+        if (length <= DMX_UNIVERSE_SIZE)
+            self->_short[i]++;
+        self->take(i, length);
+
+        uint target = (in._pio->sm[in._sm].execctrl & PIO_SM0_EXECCTRL_WRAP_BOTTOM_BITS) >> PIO_SM0_EXECCTRL_WRAP_BOTTOM_LSB;
+        dma_channel_set_write_addr(chan, in._buf, true);
+        pio_sm_exec(in._pio, in._sm, pio_encode_jmp(target - 1));
+        pio_sm_clear_fifos(in._pio, in._sm);
+    }
+}
+
+/**
+ * @brief Publishes what the DMA wrote of an input's frame
+ * @param input Input number
+ * @param length Bytes received, start code included
+ * @post The buffer is copied before the next frame's break has ended, so it is never torn
+ */
+void DmxInputs::take(unsigned input, unsigned length) {
+    _received[input]++;
+    const volatile uint8_t *buffer = _buffers[input];
+    if (buffer[0] != 0)
+        return;                         // RDM or text, not levels
+    DmxInputFrame *frame = _frames[input]->writeSlot();
+    memcpy(frame->levels, (const uint8_t *)buffer, length);
+    memset(frame->levels + length, 0, sizeof(frame->levels) - length);
+    if (!_frames[input]->publish() && _notify != nullptr)
+        _notify(_arg);                  // a superseded frame already woke the reader
+}
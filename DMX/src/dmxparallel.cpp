@@ -0,0 +1,240 @@
+#include "dmxparallel.h"
+#include "dmxparallel.pio.h"
+
+#include "hardware/clocks.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+
+// Maps each hardware alarm back to the group it paces
+#define NUM_TIMER_ALARMS 4
+static DmxParallel *volatile paced_groups[NUM_TIMER_ALARMS] = {nullptr};
+
+// Maps each DMA channel back to its group, for the completion interrupt
+// shared with DmxOutput
+#define NUM_DMA_CHANS 12
+static DmxParallel *volatile dma_groups[NUM_DMA_CHANS] = {nullptr};
+static bool dma_irq_installed = false;
+
+DmxOutput::return_code DmxParallel::begin(uint first_pin, uint count, uint prgm_offset, PIO pio)
+{
+    if (count < 1 || count > DMXPAR_MAX_UNIVERSES)
+        return DmxOutput::ERR_NO_SM_AVAILABLE;
+
+    int sm = pio_claim_unused_sm(pio, false);
+    if (sm == -1)
+        return DmxOutput::ERR_NO_SM_AVAILABLE;
+
+    int dma = dma_claim_unused_channel(false);
+    if (dma == -1)
+    {
+        pio_sm_unclaim(pio, sm);
+        return DmxOutput::ERR_NO_DMA_AVAILABLE;
+    }
+
+    // All lines idle high (mark) until the first frame
+    uint32_t mask = ((1u << count) - 1) << first_pin;
+    pio_sm_set_pins_with_mask(pio, sm, mask, mask);
+    pio_sm_set_pindirs_with_mask(pio, sm, mask, mask);
+    for (uint i = 0; i < count; i++)
+        pio_gpio_init(pio, first_pin + i);
+
+    pio_sm_config sm_conf = DmxParallel_program_get_default_config(prgm_offset);
+    sm_config_set_out_pins(&sm_conf, first_pin, count);
+    // Slots are 8 bytes, shifted out LSB first one byte per DMX bit
+    sm_config_set_out_shift(&sm_conf, true, true, 32);
+    sm_config_set_fifo_join(&sm_conf, PIO_FIFO_JOIN_TX);
+
+    // Setup the clock divider to run the state machine at exactly 1MHz
+    uint clk_div = clock_get_hz(clk_sys) / DMX_SM_FREQ;
+    sm_config_set_clkdiv(&sm_conf, clk_div);
+    pio_sm_init(pio, sm, prgm_offset + DmxParallel_wrap_target, &sm_conf);
+
+    dma_channel_config dma_conf = dma_channel_get_default_config(dma);
+    channel_config_set_transfer_data_size(&dma_conf, DMA_SIZE_32);
+    channel_config_set_dreq(&dma_conf, pio_get_dreq(pio, sm, true));
+    dma_channel_set_write_addr(dma, &pio->txf[sm], false);
+    dma_channel_set_config(dma, &dma_conf, false);
+
+    dma_groups[dma] = this;
+    if (!dma_irq_installed)
+    {
+        irq_add_shared_handler(DMX_OUTPUT_DMA_IRQ, dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(DMX_OUTPUT_DMA_IRQ, true);
+        dma_irq_installed = true;
+    }
+    dma_channel_set_irq1_enabled(dma, true);
+
+    _sliced = new uint32_t[2 * (DMX_UNIVERSE_SIZE + 1)];
+    _prgm_offset = prgm_offset;
+    _first_pin = first_pin;
+    _count = count;
+    _pio = pio;
+    _sm = sm;
+    _dma = dma;
+
+    return DmxOutput::SUCCESS;
+}
+
+void DmxParallel::start_frame()
+{
+    pio_sm_set_enabled(_pio, _sm, false);
+    // Mask the spurious completion interrupt an abort can raise (RP2040-E13)
+    dma_channel_set_irq1_enabled(_dma, false);
+    dma_channel_abort(_dma);
+    dma_channel_acknowledge_irq1(_dma);
+    dma_channel_set_irq1_enabled(_dma, true);
+    pio_sm_restart(_pio, _sm);
+    pio_sm_clear_fifos(_pio, _sm);
+
+    // Mark the OSR empty so autopull starts on the first slot, then
+    // start from the break
+    pio_sm_exec(_pio, _sm, pio_encode_out(pio_null, 32));
+    pio_sm_exec(_pio, _sm, pio_encode_jmp(_prgm_offset));
+    pio_sm_set_enabled(_pio, _sm, true);
+
+    dma_channel_transfer_from_buffer_now(_dma, _sliced, 2 * _sliced_length);
+}
+
+void DmxParallel::write_dmx(const uint8_t *const universes[], uint length)
+{
+    const uint8_t *lanes[DMXPAR_MAX_UNIVERSES] = {nullptr};
+    for (uint i = 0; i < _count; i++)
+        lanes[i] = universes[i];
+    if (length > DMX_UNIVERSE_SIZE + 1)
+        length = DMX_UNIVERSE_SIZE + 1;
+
+    bitslice_transpose(lanes, _sliced, length);
+    _sliced_length = length;
+    start_frame();
+}
+
+void DmxParallel::repeat_dmx()
+{
+    if (_sliced_length > 0)
+        start_frame();
+}
+
+void DmxParallel::dma_irq_handler()
+{
+    for (int i = 0; i < NUM_DMA_CHANS; i++)
+    {
+        DmxParallel *instance = dma_groups[i];
+        if (instance == nullptr || !dma_channel_get_irq1_status(i))
+            continue;
+        dma_channel_acknowledge_irq1(i);
+        if (instance->_done_cb != nullptr)
+            instance->_done_cb(instance, instance->_done_user_data);
+    }
+}
+
+void DmxParallel::on_frame_done(done_callback done_cb, void *user_data)
+{
+    uint32_t save = save_and_disable_interrupts();
+    _done_user_data = user_data;
+    _done_cb = done_cb;
+    restore_interrupts(save);
+}
+
+void DmxParallel::refresh_alarm_handler(uint alarm_num)
+{
+    DmxParallel *instance = paced_groups[alarm_num];
+    if (instance == nullptr)
+        return;
+
+    // Schedule against the previous target so latency never accumulates
+    // into drift; refreshes that were missed entirely are dropped
+    uint64_t now = time_us_64();
+    do {
+        instance->_next_frame_us += instance->_period_us;
+    } while (instance->_next_frame_us <= now ||
+             hardware_alarm_set_target(alarm_num, instance->_next_frame_us));
+
+    if (instance->busy())
+        return;
+
+    const uint8_t *universes[DMXPAR_MAX_UNIVERSES] = {nullptr};
+    uint length = 0;
+    bool changed = instance->_frame_cb(instance, universes, &length, instance->_frame_user_data);
+    if (changed || length != instance->_sliced_length)
+        instance->write_dmx(universes, length);
+    else
+        instance->repeat_dmx();
+
+    // Never start the next frame before this one has been clocked out
+    uint64_t done = now + DMX_FRAME_US(instance->_sliced_length);
+    if (instance->_next_frame_us < done)
+    {
+        instance->_next_frame_us = done;
+        if (hardware_alarm_set_target(alarm_num, done))
+            refresh_alarm_handler(alarm_num);
+    }
+}
+
+DmxOutput::return_code DmxParallel::start_continuous(uint refresh_hz, frame_callback frame_cb, void *user_data)
+{
+    if (_alarm < 0)
+    {
+        int alarm = hardware_alarm_claim_unused(false);
+        if (alarm == -1)
+            return DmxOutput::ERR_NO_ALARM_AVAILABLE;
+        _alarm = alarm;
+    }
+    else
+    {
+        hardware_alarm_cancel(_alarm);
+    }
+
+    _frame_cb = frame_cb;
+    _frame_user_data = user_data;
+    _sliced_length = 0;
+    set_refresh_rate(refresh_hz);
+    paced_groups[_alarm] = this;
+    hardware_alarm_set_callback(_alarm, refresh_alarm_handler);
+
+    _next_frame_us = time_us_64();
+    do {
+        _next_frame_us += _period_us;
+    } while (hardware_alarm_set_target(_alarm, _next_frame_us));
+    return DmxOutput::SUCCESS;
+}
+
+void DmxParallel::set_refresh_rate(uint refresh_hz)
+{
+    if (refresh_hz == 0)
+        refresh_hz = 1;
+    _period_us = 1000000 / refresh_hz;
+}
+
+void DmxParallel::stop_continuous()
+{
+    if (_alarm < 0)
+        return;
+    hardware_alarm_cancel(_alarm);
+    hardware_alarm_set_callback(_alarm, nullptr);
+    paced_groups[_alarm] = nullptr;
+    hardware_alarm_unclaim(_alarm);
+    _alarm = -1;
+}
+
+bool DmxParallel::busy()
+{
+    if (dma_channel_is_busy(_dma))
+        return true;
+
+    return !pio_sm_is_tx_fifo_empty(_pio, _sm);
+}
+
+void DmxParallel::end()
+{
+    stop_continuous();
+    pio_sm_set_enabled(_pio, _sm, false);
+    dma_channel_set_irq1_enabled(_dma, false);
+    dma_channel_abort(_dma);
+    dma_channel_acknowledge_irq1(_dma);
+    dma_groups[_dma] = nullptr;
+    dma_channel_unclaim(_dma);
+    pio_sm_unclaim(_pio, _sm);
+    delete[] _sliced;
+    _sliced = nullptr;
+}
@@ -0,0 +1,148 @@
+#include "effects.h"
+#include "curves.h"
+
+#include <string.h>
+
+EffectEngine::EffectEngine() : _count(0), _universes(0), _seed(0x2545F491u) {
+    memset(_perUniverse, 0, sizeof(_perUniverse));
+}
+
+/**
+ * @brief Copies s into a free slot
+ */
+EffectEngine::return_code EffectEngine::claim(const slot &s) {
+    if (_count >= EFFECT_MAX_SLOTS)
+        return ERR_NO_SLOT;
+    _slots[_count++] = s;
+    if (_perUniverse[s.universe]++ == 0)
+        _universes |= 1u << s.universe;
+    return SUCCESS;
+}
+
+/**
+ * @brief Frees slot i by moving the last running effect into it
+ */
+void EffectEngine::release(size_t i) {
+    if (--_perUniverse[_slots[i].universe] == 0)
+        _universes &= ~(1u << _slots[i].universe);
+    if (i != --_count)
+        _slots[i] = _slots[_count];
+}
+
+/**
+ * @brief xorshift32, plenty for flicker
+ */
+uint32_t EffectEngine::random() {
+    _seed ^= _seed << 13;
+    _seed ^= _seed >> 17;
+    _seed ^= _seed << 5;
+    return _seed;
+}
+
+EffectEngine::return_code EffectEngine::start(uint8_t universe, uint16_t first, uint16_t last,
+                                              effect_wave wave, uint8_t level, uint32_t period_ms) {
+    if (universe >= EFFECT_MAX_UNIVERSES || first < 1 || last > EFFECT_CHANNELS || first > last)
+        return ERR_BAD_CHANNEL;
+    if (wave == EFFECT_NONE || wave >= EFFECT_STOP)
+        return ERR_BAD_WAVE;
+    int free = EFFECT_MAX_SLOTS - (int)_count;
+    for (size_t i = 0; i < _count; i++) {
+        const slot &s = _slots[i];
+        if (s.universe != universe || s.last < first || s.first > last)
+            continue;
+        if (s.first >= first && s.last <= last)
+            free++;             // stopped whole below
+        else if (s.first < first && s.last > last)
+            free--;             // split below, the channels above take a slot
+    }
+    if (free <= 0)
+        return ERR_NO_SLOT;     // checked first, so a failed start changes nothing
+    stop(universe, first, last);
+    if (period_ms == 0)
+        period_ms = EFFECT_DEFAULT_PERIOD_MS;
+    else if (period_ms < 2)
+        period_ms = 2;          // a whole cycle per millisecond would not fit the rate
+
+    uint32_t channels = last - first + 1;
+    slot s;
+    s.phase = 0;
+    s.rate = (uint32_t)((0x100000000ull + period_ms - 1) / period_ms);     // rounded up, so a step lands on time
+    s.spacing = channels > 1 ? (uint32_t)(0x100000000ull / channels) : 0xFFFFFFFFu;
+    s.first = first;
+    s.last = last;
+    s.origin = first;
+    s.universe = universe;
+    s.wave = wave;
+    s.level = level;
+    s.fresh = true;
+    return claim(s);
+}
+
+EffectEngine::return_code EffectEngine::stop(uint8_t universe, uint16_t first, uint16_t last) {
+    if (universe >= EFFECT_MAX_UNIVERSES || _perUniverse[universe] == 0)
+        return SUCCESS;
+    size_t i = 0;
+    while (i < _count) {
+        slot &s = _slots[i];
+        if (s.universe != universe || s.last < first || s.first > last) {
+            i++;
+        } else if (s.first >= first && s.last <= last) {
+            release(i);         // the last effect moves into i and is checked next
+        } else if (s.first >= first) {
+            s.first = last + 1;
+            i++;
+        } else if (s.last <= last) {
+            s.last = first - 1;
+            i++;
+        } else {
+            // Stopped in the middle: the channels above carry on in a slot of their own.
+            // No other effect overlaps first .. last then, so nothing has changed yet
+            if (_count >= EFFECT_MAX_SLOTS)
+                return ERR_NO_SLOT;
+            slot above = s;
+            above.first = last + 1;
+            s.last = first - 1;
+            claim(above);
+            i++;
+        }
+    }
+    return SUCCESS;
+}
+
+void EffectEngine::step(uint32_t elapsed_ms, uint8_t *const frames[EFFECT_MAX_UNIVERSES],
+                        ChannelSet *const dirty[EFFECT_MAX_UNIVERSES]) {
+    for (size_t i = 0; i < _count; i++) {
+        slot &s = _slots[i];
+        uint64_t advance = (uint64_t)s.rate * elapsed_ms;
+        s.phase += (uint32_t)advance;
+        uint8_t *frame = frames[s.universe];
+        if (frame == nullptr)
+            continue;
+        ChannelSet *changed = dirty != nullptr ? dirty[s.universe] : nullptr;
+        bool all = s.fresh || (advance >> 32) != 0;
+        s.fresh = false;
+
+        // Phase of the first channel; each channel after it trails by spacing
+        uint32_t p = s.phase - (uint32_t)(s.first - s.origin) * s.spacing;
+        const uint8_t *wave = s.wave == EFFECT_SINE ? wave_sine.level :
+                              s.wave == EFFECT_TRIANGLE ? wave_triangle.level : wave_square.level;
+        for (uint32_t ch = s.first; ch <= s.last; ch++, p -= s.spacing) {
+            uint8_t level;
+            if (s.wave == EFFECT_CHASE) {
+                level = p < s.spacing ? s.level : 0;
+            } else if (s.wave == EFFECT_FLICKER) {
+                // A new level each time the channel's phase wraps
+                if (!all && p >= (uint32_t)advance)
+                    continue;
+                level = scale8((random() >> 24) | 0x40, s.level);
+            } else {
+                level = scale8(wave[p >> 24], s.level);
+            }
+            if (frame[ch] == level)
+                continue;
+            frame[ch] = level;
+            if (changed != nullptr)
+                changed->set(ch);
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#include "fade.h"
+
+#include <string.h>
+
+FadeEngine::FadeEngine() : _count(0), _universes(0) {
+    memset(_perUniverse, 0, sizeof(_perUniverse));
+    memset(_index, 0, sizeof(_index));
+}
+
+FadeEngine::return_code FadeEngine::start(uint8_t universe, uint16_t channel, uint8_t current,
+                                          uint8_t target, uint32_t time_ms) {
+    if (universe >= FADE_MAX_UNIVERSES || channel < 1 || channel > FADE_CHANNELS)
+        return ERR_BAD_CHANNEL;
+    if (time_ms == 0) {
+        cancel(universe, channel, 1);
+        return SUCCESS;
+    }
+
+    size_t i = _index[universe][channel];
+    if (i == 0) {
+        if (_count >= FADE_MAX_SLOTS)
+            return ERR_NO_SLOT;
+        i = _count++;
+        _index[universe][channel] = i + 1;
+        if (_perUniverse[universe]++ == 0)
+            _universes |= 1u << universe;
+    } else {
+        i--;
+    }
+
+    slot &s = _slots[i];
+    s.level = (int32_t)current << 16;
+    s.step = (((int32_t)target << 16) - s.level) / (int32_t)time_ms;
+    s.remaining = time_ms;
+    s.channel = channel;
+    s.universe = universe;
+    s.target = target;
+    return SUCCESS;
+}
+
+/**
+ * @brief Frees slot i by moving the last running fade into it
+ */
+void FadeEngine::release(size_t i) {
+    slot &s = _slots[i];
+    _index[s.universe][s.channel] = 0;
+    if (--_perUniverse[s.universe] == 0)
+        _universes &= ~(1u << s.universe);
+
+    if (i != --_count) {
+        s = _slots[_count];
+        _index[s.universe][s.channel] = i + 1;
+    }
+}
+
+void FadeEngine::cancel(uint8_t universe, uint16_t first, uint16_t count) {
+    if (universe >= FADE_MAX_UNIVERSES || _perUniverse[universe] == 0)
+        return;
+    uint32_t last = (uint32_t)first + count - 1;
+    if (last > FADE_CHANNELS)
+        last = FADE_CHANNELS;
+    for (uint32_t ch = first < 1 ? 1 : first; ch <= last; ch++) {
+        if (_index[universe][ch] != 0)
+            release(_index[universe][ch] - 1);
+    }
+}
+
+void FadeEngine::step(uint32_t elapsed_ms, uint8_t *const frames[FADE_MAX_UNIVERSES],
+                      ChannelSet *const dirty[FADE_MAX_UNIVERSES]) {
+    size_t i = 0;
+    while (i < _count) {
+        slot &s = _slots[i];
+        uint8_t *frame = frames[s.universe];
+        if (dirty != nullptr && dirty[s.universe] != nullptr)
+            dirty[s.universe]->set(s.channel);
+        if (elapsed_ms >= s.remaining) {
+            if (frame != nullptr)
+                frame[s.channel] = s.target;
+            release(i);         // the last fade moves into i and is stepped next
+            continue;
+        }
+        // step * elapsed never exceeds the distance left, so it cannot overflow
+        s.remaining -= elapsed_ms;
+        s.level += s.step * (int32_t)elapsed_ms;
+        if (frame != nullptr)
+            frame[s.channel] = (uint32_t)(s.level + 0x8000) >> 16;
+        i++;
+    }
+}
@@ -0,0 +1,96 @@
+#include "layers.h"
+
+#include <string.h>
+
+LayerStack::LayerStack() {
+    memset(_levels, 0, sizeof(_levels));
+    for (int l = 0; l < LAYER_COUNT; l++)
+        _mode[l] = MERGE_LTP;
+    _mode[LAYER_EFFECTS] = MERGE_HTP;
+    _mode[LAYER_NETWORK] = MERGE_HTP;
+}
+
+void LayerStack::setMode(layer l, merge mode) {
+    if (_mode[l] == mode)
+        return;
+    _mode[l] = mode;
+    _dirty[l] |= _owned[l];
+}
+
+void LayerStack::fill(layer l, unsigned first, unsigned count, uint8_t level) {
+    if (first < 1 || first > LAYER_CHANNELS || count == 0)
+        return;
+    unsigned last = first + count - 1;
+    if (last > LAYER_CHANNELS)
+        last = LAYER_CHANNELS;
+    memset(_levels[l] + first, level, last - first + 1);
+    _owned[l].setRange(first, last);
+    _dirty[l].setRange(first, last);
+}
+
+void LayerStack::load(layer l, unsigned first, const uint8_t *levels, unsigned count) {
+    if (first < 1 || first > LAYER_CHANNELS || count == 0)
+        return;
+    unsigned last = first + count - 1;
+    if (last > LAYER_CHANNELS)
+        last = LAYER_CHANNELS;
+    // Only channels that change are marked, so reloading a mostly unchanged
+    // frame leaves little for compose()
+    for (unsigned ch = first; ch <= last; ch++, levels++) {
+        if (_levels[l][ch] == *levels && _owned[l].test(ch))
+            continue;
+        _levels[l][ch] = *levels;
+        _dirty[l].set(ch);
+    }
+    _owned[l].setRange(first, last);
+}
+
+void LayerStack::release(layer l, unsigned first, unsigned count) {
+    if (first < 1 || first > LAYER_CHANNELS || count == 0)
+        return;
+    unsigned last = first + count - 1;
+    if (last > LAYER_CHANNELS)
+        last = LAYER_CHANNELS;
+    _owned[l].resetRange(first, last);
+    _dirty[l].setRange(first, last);
+}
+
+void LayerStack::releaseAll(layer l) {
+    _dirty[l] |= _owned[l];
+    _owned[l].clear();
+}
+
+bool LayerStack::compose(uint8_t *frame) {
+    bool changed = false;
+    for (int w = 0; w < CHANSET_WORDS; w++) {
+        uint32_t dirty = 0;
+        for (int l = 0; l < LAYER_COUNT; l++) {
+            dirty |= _dirty[l].words[w];
+            _dirty[l].words[w] = 0;
+        }
+        if (dirty == 0)
+            continue;
+        changed = true;
+
+        // Owned words are loaded once per 32 channels, not once per channel
+        uint32_t owned[LAYER_COUNT];
+        for (int l = 0; l < LAYER_COUNT; l++)
+            owned[l] = _owned[l].words[w];
+
+        while (dirty != 0) {
+            unsigned bit = __builtin_ctz(dirty);
+            unsigned ch = (w << 5) + bit + 1;
+            uint8_t out = 0;
+            for (int l = 0; l < LAYER_COUNT; l++) {
+                if (!(owned[l] & (1u << bit)))
+                    continue;
+                uint8_t level = _levels[l][ch];
+                if (_mode[l] == MERGE_LTP || level > out)
+                    out = level;
+            }
+            frame[ch] = out;
+            dirty &= dirty - 1;
+        }
+    }
+    return changed;
+}
@@ -0,0 +1,66 @@
+#include "looks.h"
+
+#include <string.h>
+
+/**
+ * @brief Finds the next run of a look
+ * @param frame Levels of one universe, index 0 is the start code
+ * @param from First channel to look at
+ * @param first Set to the first channel of the run
+ * @return Channels in the run, 0 if no channel from on is lit
+ * @post The run starts and ends on a lit channel, and holds no more
+ *       than LOOK_GAP dark channels in a row
+ */
+static unsigned findRun(const uint8_t *frame, unsigned from, unsigned &first) {
+    while (from <= LOOK_CHANNELS && frame[from] == 0)
+        from++;
+    if (from > LOOK_CHANNELS)
+        return 0;
+    first = from;
+    unsigned end = from + 1;            // one past the last lit channel in the run
+    unsigned limit = from + LOOK_RUN_MAX;
+    if (limit > LOOK_CHANNELS + 1)
+        limit = LOOK_CHANNELS + 1;
+    for (unsigned ch = end; ch < limit && ch - end <= LOOK_GAP; ch++) {
+        if (frame[ch] != 0)
+            end = ch + 1;
+    }
+    return end - first;
+}
+
+size_t look_encode(const uint8_t *const frames[LOOK_UNIVERSES], LookCursor &at, uint8_t *out, size_t max) {
+    size_t written = 0;
+    for (; at.universe < LOOK_UNIVERSES; at.universe++, at.channel = 1) {
+        const uint8_t *frame = frames[at.universe];
+        if (frame == nullptr)
+            continue;
+        unsigned first;
+        while (unsigned count = findRun(frame, at.channel, first)) {
+            LookRun run = {(uint16_t)first, at.universe, (uint8_t)count};
+            if (written + run.bytes() > max)
+                return written;
+            if (out != nullptr) {
+                memcpy(out + written, &run, sizeof(run));
+                memcpy(out + written + sizeof(run), frame + first, count);
+                if (count & 1)
+                    out[written + sizeof(run) + count] = 0;
+            }
+            written += run.bytes();
+            at.channel = first + count;
+        }
+    }
+    return written;
+}
+
+size_t look_size(const uint8_t *const frames[LOOK_UNIVERSES]) {
+    LookCursor at;
+    return look_encode(frames, at, nullptr, SIZE_MAX);
+}
+
+void look_decode(const uint8_t *look, size_t length, uint8_t *const frames[LOOK_UNIVERSES]) {
+    const uint8_t *end = look + length;
+    while (const LookRun *run = look_next(look, end)) {
+        if (frames[run->universe] != nullptr)
+            memcpy(frames[run->universe] + run->first, run->levels(), run->count);
+    }
+}
@@ -0,0 +1,72 @@
+#include "masters.h"
+
+#include <string.h>
+
+MasterBank::MasterBank() : _grand(MASTER_FULL), _stale(0) {
+    memset(_level, MASTER_FULL, sizeof(_level));
+}
+
+void MasterBank::setGrand(uint8_t level) {
+    if (level != _grand)
+        _stale = (1u << MASTER_UNIVERSES) - 1;
+    _grand = level;
+}
+
+/**
+ * @brief Marks the universes a submaster has channels in as stale
+ */
+MasterBank::return_code MasterBank::setLevel(unsigned sub, uint8_t level) {
+    if (sub >= MASTER_SUBMASTERS)
+        return ERR_BAD_MASTER;
+    if (level == _level[sub])
+        return SUCCESS;
+    _level[sub] = level;
+    for (unsigned u = 0; u < MASTER_UNIVERSES; u++) {
+        if (!_mask[sub][u].empty())
+            _stale |= 1u << u;
+    }
+    return SUCCESS;
+}
+
+MasterBank::return_code MasterBank::assign(unsigned sub, unsigned universe, unsigned first, unsigned last) {
+    if (sub >= MASTER_SUBMASTERS)
+        return ERR_BAD_MASTER;
+    if (universe >= MASTER_UNIVERSES || first < 1 || last > CHANSET_CHANNELS || first > last)
+        return ERR_BAD_CHANNEL;
+    _mask[sub][universe].setRange(first, last);
+    if (_level[sub] != MASTER_FULL)
+        _stale |= 1u << universe;
+    return SUCCESS;
+}
+
+MasterBank::return_code MasterBank::clear(unsigned sub) {
+    if (sub >= MASTER_SUBMASTERS)
+        return ERR_BAD_MASTER;
+    for (unsigned u = 0; u < MASTER_UNIVERSES; u++) {
+        if (!_mask[sub][u].empty() && _level[sub] != MASTER_FULL)
+            _stale |= 1u << u;
+        _mask[sub][u].clear();
+    }
+    return SUCCESS;
+}
+
+bool MasterBank::build(unsigned universe, uint8_t scale[CHANSET_CHANNELS + 1]) {
+    if (universe >= MASTER_UNIVERSES)
+        return false;
+    _stale &= ~(1u << universe);
+    memset(scale + 1, _grand, CHANSET_CHANNELS);
+    scale[0] = MASTER_FULL;
+    bool scaled = _grand != MASTER_FULL;
+
+    // Submasters at full scale nothing, so only pulled down faders cost anything
+    for (unsigned s = 0; s < MASTER_SUBMASTERS; s++) {
+        uint8_t level = _level[s];
+        if (level == MASTER_FULL)
+            continue;
+        for (unsigned ch : _mask[s][universe]) {
+            scale[ch] = scale8(scale[ch], level);
+            scaled = true;
+        }
+    }
+    return scaled;
+}
@@ -0,0 +1,149 @@
+#include "merge.h"
+
+#include <string.h>
+
+#define BYTES_HIGH 0x80808080u
+#define BYTES_LOW 0x7F7F7F7Fu
+#define BYTES_ONE 0x01010101u
+
+/**
+ * @brief 0xFF in every byte of x that is not zero, 0x00 elsewhere
+ */
+static inline uint32_t nonzero_bytes(uint32_t x) {
+    uint32_t high = (((x & BYTES_LOW) + BYTES_LOW) | x) & BYTES_HIGH;
+    return (high >> 7) * 0xFF;
+}
+
+/**
+ * @brief Per byte unsigned maximum of a and b
+ */
+static inline uint32_t max_bytes(uint32_t a, uint32_t b) {
+    // High bit of each byte of d is set if the low 7 bits of a >= those of b;
+    // the forced high bit of a keeps borrows from crossing bytes
+    uint32_t d = (a | BYTES_HIGH) - (b & BYTES_LOW);
+    uint32_t ge = ((a & ~b) | (~(a ^ b) & d)) & BYTES_HIGH;
+    uint32_t mask = (ge >> 7) * 0xFF;
+    return (a & mask) | (b & ~mask);
+}
+
+// Byte masks for each combination of 4 LTP bits, bit i selects byte i
+static const uint32_t expand_nibble[16] = {
+    0x00000000, 0x000000FF, 0x0000FF00, 0x0000FFFF,
+    0x00FF0000, 0x00FF00FF, 0x00FFFF00, 0x00FFFFFF,
+    0xFF000000, 0xFF0000FF, 0xFF00FF00, 0xFF00FFFF,
+    0xFFFF0000, 0xFFFF00FF, 0xFFFFFF00, 0xFFFFFFFF,
+};
+
+SourceMerge::SourceMerge() : _merged(0), _active(0) {
+    memset(_levels, 0, sizeof(_levels));
+    memset(_count, 0, sizeof(_count));
+    memset(_owner, 0, sizeof(_owner));
+    memset(_out, 0, sizeof(_out));
+    memset(_stamp, 0, sizeof(_stamp));
+}
+
+SourceMerge::return_code SourceMerge::update(unsigned source, const uint8_t *levels, unsigned count,
+                                             uint32_t now_ms) {
+    if (source >= MERGE_MAX_SOURCES)
+        return ERR_BAD_SOURCE;
+    if (count > MERGE_CHANNELS)
+        count = MERGE_CHANNELS;
+
+    uint32_t *frame = _levels[source];
+    uint32_t mine = source * BYTES_ONE;
+    unsigned words = ((count > _count[source] ? count : _count[source]) + 3) / 4;  // zeros past both stay zeros
+    for (unsigned w = 0; w < words; w++) {
+        // levels may be unaligned, so words are assembled a byte at a time
+        unsigned c = w * 4;
+        uint32_t word = 0;
+        for (unsigned b = 0; b < 4 && c + b < count; b++)
+            word |= (uint32_t)levels[c + b] << (8 * b);
+
+        uint32_t moved = nonzero_bytes(word ^ frame[w]);
+        _owner[w] = (_owner[w] & ~moved) | (mine & moved);
+        frame[w] = word;
+    }
+    _count[source] = count;
+    _stamp[source] = now_ms;
+    _active |= 1u << source;
+    return SUCCESS;
+}
+
+void SourceMerge::drop(unsigned source) {
+    if (!active(source))
+        return;
+    _active &= ~(1u << source);
+    memset(_levels[source], 0, sizeof(_levels[source]));
+    _count[source] = 0;
+
+    int heir = -1;
+    for (unsigned s = 0; s < MERGE_MAX_SOURCES; s++) {
+        if (active(s) && (heir < 0 || (int32_t)(_stamp[s] - _stamp[heir]) > 0))
+            heir = s;
+    }
+    if (heir < 0)
+        return;
+    uint32_t dropped = source * BYTES_ONE;
+    uint32_t taken = heir * BYTES_ONE;
+    for (unsigned w = 0; w < MERGE_WORDS; w++) {
+        uint32_t orphans = ~nonzero_bytes(_owner[w] ^ dropped);
+        _owner[w] = (_owner[w] & ~orphans) | (taken & orphans);
+    }
+}
+
+void SourceMerge::expire(uint32_t now_ms, uint32_t timeout_ms) {
+    for (unsigned s = 0; s < MERGE_MAX_SOURCES; s++) {
+        if (active(s) && now_ms - _stamp[s] > timeout_ms)
+            drop(s);
+    }
+}
+
+void SourceMerge::setLTP(unsigned first, unsigned last, bool ltp) {
+    if (ltp)
+        _ltp.setRange(first, last);
+    else
+        _ltp.resetRange(first, last);
+}
+
+unsigned SourceMerge::count() const {
+    unsigned count = 0;
+    for (unsigned s = 0; s < MERGE_MAX_SOURCES; s++) {
+        if (active(s) && _count[s] > count)
+            count = _count[s];
+    }
+    return count;
+}
+
+bool SourceMerge::merge(ChannelSet *changed) {
+    bool any = false;
+    unsigned count = this->count();
+    unsigned words = ((count > _merged ? count : _merged) + 3) / 4;     // as far as the output may move
+    _merged = count;
+    for (unsigned w = 0; w < words; w++) {
+        uint32_t htp = 0;
+        uint32_t ltp = 0;
+        uint32_t owner = _owner[w];
+        for (unsigned s = 0; s < MERGE_MAX_SOURCES; s++) {
+            if (!(_active & (1u << s)))
+                continue;
+            uint32_t level = _levels[s][w];
+            htp = max_bytes(htp, level);
+            ltp |= level & ~nonzero_bytes(owner ^ (s * BYTES_ONE));
+        }
+        uint32_t mode = expand_nibble[(_ltp.words[w >> 3] >> ((w & 7) * 4)) & 0xF];
+        uint32_t out = (htp & ~mode) | (ltp & mode);
+
+        uint32_t diff = out ^ _out[w];
+        if (diff == 0)
+            continue;
+        any = true;
+        _out[w] = out;
+        if (changed != nullptr) {
+            for (unsigned b = 0; b < 4; b++) {
+                if (diff & (0xFFu << (8 * b)))
+                    changed->set(w * 4 + b + 1);
+            }
+        }
+    }
+    return any;
+}
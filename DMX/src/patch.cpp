@@ -0,0 +1,128 @@
+#include "patch.h"
+
+#include <string.h>
+
+void PatchMap::scatter(uint32_t sources, const uint8_t *const logical[PATCH_MAX_SOURCES],
+                       uint8_t *const outputs[PATCH_MAX_UNIVERSES]) const {
+    for (unsigned u = 0; u < PATCH_MAX_SOURCES; u++) {
+        if (!(sources & (1u << u)) || logical[u] == nullptr)
+            continue;
+        for (unsigned i = _begin[u]; i < _begin[u + 1]; i++) {
+            const PatchRun &r = _runs[i];
+            if (outputs[r.dst_universe] != nullptr)
+                memcpy(outputs[r.dst_universe] + r.dst_first, logical[u] + r.src_first, r.count);
+        }
+    }
+}
+
+uint32_t PatchMap::targets(uint32_t sources) const {
+    uint32_t out = 0;
+    for (unsigned u = 0; u < PATCH_MAX_SOURCES; u++) {
+        if (sources & (1u << u))
+            out |= _targets[u];
+    }
+    return out;
+}
+
+PatchTable::return_code PatchTable::add(uint8_t src_universe, uint16_t src_first, uint16_t count,
+                                        uint8_t dst_universe, uint16_t dst_first) {
+    if (src_universe >= PATCH_MAX_UNIVERSES)
+        return ERR_BAD_CHANNEL;
+    return append(src_universe, src_first, count, dst_universe, dst_first);
+}
+
+PatchTable::return_code PatchTable::route(uint8_t input, uint16_t src_first, uint16_t count,
+                                          uint8_t dst_universe, uint16_t dst_first) {
+    if (input >= PATCH_MAX_INPUTS)
+        return ERR_BAD_CHANNEL;
+    return append(PATCH_INPUT(input), src_first, count, dst_universe, dst_first);
+}
+
+PatchTable::return_code PatchTable::append(uint8_t source, uint16_t src_first, uint16_t count,
+                                           uint8_t dst_universe, uint16_t dst_first) {
+    if (dst_universe >= PATCH_MAX_UNIVERSES || count < 1 ||
+        src_first < 1 || src_first + count - 1 > PATCH_CHANNELS ||
+        dst_first < 1 || dst_first + count - 1 > PATCH_CHANNELS)
+        return ERR_BAD_CHANNEL;
+    if (_count >= PATCH_MAX_RUNS)
+        return ERR_FULL;
+    PatchRun &r = _runs[_count++];
+    r.src_universe = source;
+    r.src_first = src_first;
+    r.count = count;
+    r.dst_universe = dst_universe;
+    r.dst_first = dst_first;
+    return SUCCESS;
+}
+
+void PatchTable::identity(unsigned universes) {
+    clear();
+    for (unsigned u = 0; u < universes && u < PATCH_MAX_UNIVERSES; u++)
+        add(u, 1, PATCH_CHANNELS, u, 1);
+}
+
+uint16_t PatchTable::highest(unsigned universe) const {
+    uint16_t top = 0;
+    for (size_t i = 0; i < _count; i++) {
+        const PatchRun &r = _runs[i];
+        if (r.dst_universe == universe && r.dst_first + r.count - 1 > top)
+            top = r.dst_first + r.count - 1;
+    }
+    return top;
+}
+
+/**
+ * @brief Orders runs by source, then output universe, then the
+ *        offset from channel to address, then channel, so runs that
+ *        continue each other end up side by side
+ */
+static bool before(const PatchRun &a, const PatchRun &b) {
+    if (a.src_universe != b.src_universe)
+        return a.src_universe < b.src_universe;
+    if (a.dst_universe != b.dst_universe)
+        return a.dst_universe < b.dst_universe;
+    int offsetA = a.dst_first - a.src_first;
+    int offsetB = b.dst_first - b.src_first;
+    if (offsetA != offsetB)
+        return offsetA < offsetB;
+    return a.src_first < b.src_first;
+}
+
+/**
+ * @post map holds the runs in scatter order, with runs that continue each
+ *       other on both sides merged into one
+ */
+void PatchTable::compile(PatchMap &map) const {
+    // Insertion sort: tables are small and only compiled when they are edited
+    memcpy(map._runs, _runs, _count * sizeof(PatchRun));
+    for (size_t i = 1; i < _count; i++) {
+        PatchRun r = map._runs[i];
+        size_t j = i;
+        for (; j > 0 && before(r, map._runs[j - 1]); j--)
+            map._runs[j] = map._runs[j - 1];
+        map._runs[j] = r;
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; i < _count; i++) {
+        const PatchRun &r = map._runs[i];
+        if (n > 0) {
+            PatchRun &prev = map._runs[n - 1];
+            if (prev.src_universe == r.src_universe && prev.dst_universe == r.dst_universe &&
+                prev.src_first + prev.count == r.src_first && prev.dst_first + prev.count == r.dst_first) {
+                prev.count += r.count;
+                continue;
+            }
+        }
+        map._runs[n++] = r;
+    }
+    map._count = n;
+
+    memset(map._targets, 0, sizeof(map._targets));
+    size_t i = 0;
+    for (unsigned u = 0; u <= PATCH_MAX_SOURCES; u++) {
+        map._begin[u] = i;
+        for (; i < n && map._runs[i].src_universe == u; i++)
+            map._targets[u] |= 1u << map._runs[i].dst_universe;
+    }
+}
@@ -1,74 +1,663 @@
 #include "piodmx.h"
 #include "DmxOutput.pio.h"
+#include "dmxparallel.pio.h"
 
-DMX::DMX(PIO pio) {
-    _pio = pio;
-    dmxp = new DmxOutput();
-    //dmxn = new DmxOutput();
-    for (int i = 0; i < 513; i++) {
-        dmxData[i] = i % 256;
-        //ndmxData[i] = (255 - i) % 256;
-    }
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <string.h>
+
+// Curve tables are copied out of flash so the per slot lookups in the
+// frame interrupt never miss the XIP cache. A custom curve is loaded into
+// the set not in use and the two swapped, as for Universe::shape
+static CurveLut curve_luts[2][CURVE_COUNT] = {{curve_linear, curve_square, curve_inv_square, curve_scurve}};
+static const CurveLut *volatile live_luts = curve_luts[0];
+
+DMX::DMX() {
+    for (int i = 0; i < DMX_MAX_UNIVERSES; i++)
+        ports[i] = nullptr;
+    for (int i = CURVE_CUSTOM; i < CURVE_COUNT; i++)
+        curve_luts[0][i] = curve_linear;
 }
 
 DMX::~DMX() {
-    dmxp->end();
-    //dmxn->end();
-    delete dmxp;
-   // delete dmxn;
+    for (int i = 0; i < DMX_MAX_UNIVERSES; i++) {
+        if (ports[i] == nullptr)
+            continue;
+        if (!ports[i]->parallel)
+            ports[i]->output.end();
+        delete ports[i];
+    }
+    if (group != nullptr) {
+        group->end();
+        delete group;
+    }
+}
+
+DMX::Universe *DMX::newUniverse(uint universe, uint pin) {
+    Universe *u = new Universe();
+    for (int i = 0; i < 513; i++)
+        u->dmxData[0][i] = 0;
+    memcpy(u->dmxData[1], u->dmxData[0], sizeof(u->dmxData[0]));
+    u->front = u->dmxData[0];
+    u->back = u->dmxData[1];
+    u->pin = pin;
+    u->number = universe;
+    u->swap_lock = spin_lock_instance(spin_lock_claim_unused(true));
+    return u;
+}
+
+void DMX::freeUniverse(Universe *u) {
+    spin_lock_unclaim(spin_lock_get_num(u->swap_lock));
+    delete u;
+}
+
+/**
+ * @brief Loads a PIO program into pio0 (p = 0) or pio1 (p = 1) once
+ * @param offsets Per PIO offsets of the program, -1 if not loaded yet
+ * @return true if the program is loaded in that PIO
+ */
+bool DMX::loadProgram(int p, const pio_program *program, int *offsets) {
+    PIO pio = p ? pio1 : pio0;
+    if (offsets[p] < 0) {
+        if (!pio_can_add_program(pio, program))
+            return false;
+        offsets[p] = pio_add_program(pio, program);
+    }
+    return true;
+}
+
+DmxOutput::return_code DMX::begin(uint universe, uint pin, bool inverted) {
+    if (universe >= DMX_MAX_UNIVERSES || ports[universe] != nullptr)
+        return DmxOutput::ERR_NO_SM_AVAILABLE;
+
+    Universe *u = newUniverse(universe, pin);
+    u->status = DmxOutput::ERR_INSUFFICIENT_PRGM_MEM;
+    for (int p = 0; p < 2; p++) {
+        if (!loadProgram(p, &DmxOutput_program, prgm_offset))
+            continue;
+        u->status = u->output.begin(pin, prgm_offset[p], p ? pio1 : pio0, inverted);
+        if (u->status != DmxOutput::ERR_NO_SM_AVAILABLE)
+            break;
+    }
+
+    if (u->status != DmxOutput::SUCCESS) {
+        DmxOutput::return_code status = u->status;
+        freeUniverse(u);
+        return status;
+    }
+    u->output.on_frame_done(frameDone, u);
+    ports[universe] = u;
+    if (universe + 1 > universeCount)
+        universeCount = universe + 1;
+    return DmxOutput::SUCCESS;
+}
+
+DmxOutput::return_code DMX::beginParallel(uint first_universe, uint count, uint first_pin) {
+    if (group != nullptr || count < 1 || count > DMXPAR_MAX_UNIVERSES || first_universe + count > DMX_MAX_UNIVERSES)
+        return DmxOutput::ERR_NO_SM_AVAILABLE;
+    for (uint i = 0; i < count; i++) {
+        if (ports[first_universe + i] != nullptr)
+            return DmxOutput::ERR_NO_SM_AVAILABLE;
+    }
+
+    DmxParallel *g = new DmxParallel();
+    DmxOutput::return_code status = DmxOutput::ERR_INSUFFICIENT_PRGM_MEM;
+    for (int p = 0; p < 2; p++) {
+        if (!loadProgram(p, &DmxParallel_program, group_offset))
+            continue;
+        status = g->begin(first_pin, count, group_offset[p], p ? pio1 : pio0);
+        if (status != DmxOutput::ERR_NO_SM_AVAILABLE)
+            break;
+    }
+    if (status != DmxOutput::SUCCESS) {
+        delete g;
+        return status;
+    }
+
+    for (uint i = 0; i < count; i++) {
+        Universe *u = newUniverse(first_universe + i, first_pin + i);
+        u->parallel = true;
+        u->status = DmxOutput::SUCCESS;
+        ports[first_universe + i] = u;
+    }
+    g->on_frame_done(groupDone, this);
+    group = g;
+    groupFirst = first_universe;
+    if (first_universe + count > universeCount)
+        universeCount = first_universe + count;
+    return DmxOutput::SUCCESS;
+}
+
+/**
+ * @brief Promotes a completed back buffer to the front
+ * @pre The previous frame has finished transmitting
+ * @param swapped Set if the frame differs from the last one sent
+ * @return The buffer to transmit, front or its curved copy
+ */
+uint8_t *DMX::Universe::nextFrame(bool *swapped) {
+    uint32_t save = spin_lock_blocking(swap_lock);
+    bool fresh = recurve;
+    recurve = false;
+    if (back_ready) {
+        uint8_t *sent = front;
+        front = back;
+        back = sent;
+        front_highest = back_highest;
+        back_ready = false;
+        back_stale = true;
+        fresh = true;
+    }
+    const Shaping *shaped = shape;
+    const CurveLut *luts = live_luts;
+    shaping = shaped != nullptr;
+    spin_unlock(swap_lock, save);
+    updateLength();
+    sending = true;
+    if (swapped != nullptr)
+        *swapped = fresh;
+    if (shaped == nullptr)
+        return front;
+
+    // Only a new frame, new curves or a longer frame need the curves applied again
+    if (fresh || universeSize > curved_size) {
+        if (shaped->scaled)
+            curve_apply_scaled(luts, shaped->curve, shaped->scale, front, curved, universeSize);
+        else
+            curve_apply(luts, shaped->curve, front, curved, universeSize);
+        curved_size = universeSize;
+    }
+    save = spin_lock_blocking(swap_lock);
+    shaping = false;
+    spin_unlock(swap_lock, save);
+    return curved;
+}
+
+/**
+ * @brief Picks the length of the frame about to be sent
+ * @post universeSize covers the highest non-zero or patched slot within
+ *       minSlots..maxSlots. Growth is immediate, shrinking waits
+ *       DMX_SHRINK_HOLDOFF_FRAMES frames
+ */
+void DMX::Universe::updateLength() {
+    uint slots = front_highest;
+    if (patchedSlots > slots)
+        slots = patchedSlots;
+    if (minSlots > slots)
+        slots = minSlots;
+    if (slots > maxSlots)
+        slots = maxSlots;
+
+    if (slots + 1 >= universeSize) {
+        universeSize = slots + 1;
+        shrink_holdoff = DMX_SHRINK_HOLDOFF_FRAMES;
+    } else if (shrink_holdoff > 0) {
+        shrink_holdoff--;
+    } else {
+        universeSize = slots + 1;
+    }
+}
+
+uint8_t *DMX::frameSource(DmxOutput *output, uint *length, void *user_data) {
+    Universe *u = (Universe *)user_data;
+    uint8_t *frame = u->nextFrame();
+    *length = u->universeSize;
+    return frame;
+}
+
+/**
+ * @brief Collects the next frame of every universe in the parallel group
+ * @return true if any member swapped in a new frame
+ */
+bool DMX::groupSource(DmxParallel *group, const uint8_t *universes[DMXPAR_MAX_UNIVERSES],
+                      uint *length, void *user_data) {
+    DMX *dmx = (DMX *)user_data;
+    bool changed = false;
+    uint longest = 1;
+    for (uint i = 0; i < group->count(); i++) {
+        Universe *u = dmx->ports[dmx->groupFirst + i];
+        bool swapped;
+        universes[i] = u->nextFrame(&swapped);
+        changed |= swapped;
+        if (u->universeSize > longest)
+            longest = u->universeSize;
+    }
+    *length = longest;
+    return changed;
+}
+
+/**
+ * @brief Marks a universe's frame as sent, from the DMA interrupt
+ * @param woken Set if a higher priority task was woken
+ */
+void DMX::finishFrame(Universe *u, long *woken) {
+    u->sending = false;
+    if (u->waiter != nullptr)
+        vTaskNotifyGiveIndexedFromISR(u->waiter, DMX_NOTIFY_INDEX, woken);
+    if (u->hook != nullptr)
+        u->hook(u->number, u->hook_data);
+}
+
+void DMX::frameDone(DmxOutput *output, void *user_data) {
+    BaseType_t woken = pdFALSE;
+    finishFrame((Universe *)user_data, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+void DMX::groupDone(DmxParallel *group, void *user_data) {
+    DMX *dmx = (DMX *)user_data;
+    BaseType_t woken = pdFALSE;
+    for (uint i = 0; i < group->count(); i++)
+        finishFrame(dmx->ports[dmx->groupFirst + i], &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+void DMX::sendDMX(uint universe) {
+    if (!active(universe))
+        return;
+    Universe *u = ports[universe];
+    if (u->parallel) {
+        const uint8_t *universes[DMXPAR_MAX_UNIVERSES] = {nullptr};
+        uint length;
+        groupSource(group, universes, &length, this);
+        group->write_dmx(universes, length);
+        return;
+    }
+    uint8_t *frame = u->nextFrame();
+    u->output.write_dmx(frame, u->universeSize);
+}
+
+void DMX::sendTogether(uint32_t universes) {
+    uint8_t *frames[DMX_MAX_UNIVERSES] = {nullptr};
+    const uint8_t *grouped[DMXPAR_MAX_UNIVERSES] = {nullptr};
+    uint groupLength = 0;
+    bool groupDue = false;
+    for (uint n = 0; n < DMX_MAX_UNIVERSES; n++) {
+        if (!(universes & (1u << n)) || !active(n))
+            continue;
+        if (!ports[n]->parallel)
+            frames[n] = ports[n]->nextFrame();          // swaps and applies curves, the slow part
+        else if (!groupDue)
+            groupDue = true;
+    }
+    if (groupDue)
+        groupSource(group, grouped, &groupLength, this);
+
+    uint32_t save = save_and_disable_interrupts();
+    if (groupDue)
+        group->write_dmx(grouped, groupLength);
+    for (uint n = 0; n < DMX_MAX_UNIVERSES; n++) {
+        if (frames[n] != nullptr)
+            ports[n]->output.write_dmx(frames[n], ports[n]->universeSize);
+    }
+    restore_interrupts(save);
+}
+
+/**
+ * @brief Hands frame timing for a universe to the shared hardware alarm
+ * @param universe The universe to pace
+ * @param refresh_hz Frames per second
+ * @post Frames are sent from interrupt context, sendDMX() must not be called
+ */
+DmxOutput::return_code DMX::startRefresh(uint universe, uint refresh_hz) {
+    if (!active(universe))
+        return DmxOutput::ERR_NO_SM_AVAILABLE;
+    if (ports[universe]->parallel) {
+        for (uint i = 0; i < group->count(); i++)
+            ports[groupFirst + i]->refresh_hz = refresh_hz;
+        return group->start_continuous(refresh_hz, groupSource, this);
+    }
+    ports[universe]->refresh_hz = refresh_hz;
+    return ports[universe]->output.start_continuous(refresh_hz, frameSource, ports[universe]);
+}
+
+/**
+ * @brief Changes the frame rate of a continuously refreshed universe
+ * @return false, changing nothing, if the universe is not refreshed
+ *         continuously; its frames go out when sent
+ */
+bool DMX::setRefreshRate(uint universe, uint refresh_hz) {
+    if (!active(universe) || ports[universe]->refresh_hz == 0 || refresh_hz == 0)
+        return false;
+    if (ports[universe]->parallel) {
+        for (uint i = 0; i < group->count(); i++)
+            ports[groupFirst + i]->refresh_hz = refresh_hz;
+        group->set_refresh_rate(refresh_hz);
+        return true;
+    }
+    ports[universe]->refresh_hz = refresh_hz;
+    ports[universe]->output.set_refresh_rate(refresh_hz);
+    return true;
 }
 
-void DMX::begin(int pinp/*, int pinn*/) {
-    this->pinp = pinp;
-    //this->pinn = pinn;
-    uint prgm_offset = pio_add_program(_pio, &DmxOutput_program);
-    _pstatus = dmxp->begin(pinp, prgm_offset, _pio, false);
-    //_nstatus = dmxn->begin(pinn, prgm_offset, _pio, true);
-    
+void DMX::stopRefresh(uint universe) {
+    if (!active(universe))
+        return;
+    if (ports[universe]->parallel) {
+        for (uint i = 0; i < group->count(); i++)
+            ports[groupFirst + i]->refresh_hz = 0;
+        group->stop_continuous();
+        return;
+    }
+    ports[universe]->refresh_hz = 0;
+    ports[universe]->output.stop_continuous();
 }
 
-void DMX::sendDMX() {
-    dmxp->write_dmx(dmxData, universeSize);
+/**
+ * @brief Sets the longest frame sent for a universe
+ * @param slots Number of channels after the start code, clamped to 1..512
+ */
+void DMX::setLength(uint universe, uint slots) {
+    if (!active(universe))
+        return;
+    if (slots < 1)
+        slots = 1;
+    if (slots > DMX_UNIVERSE_SIZE)
+        slots = DMX_UNIVERSE_SIZE;
+    ports[universe]->maxSlots = slots;
+}
+
+/**
+ * @brief Sets the shortest frame sent for a universe
+ * @param slots Number of channels after the start code, clamped to 1..512
+ */
+void DMX::setMinLength(uint universe, uint slots) {
+    if (!active(universe))
+        return;
+    if (slots < 1)
+        slots = 1;
+    if (slots > DMX_UNIVERSE_SIZE)
+        slots = DMX_UNIVERSE_SIZE;
+    ports[universe]->minSlots = slots;
+}
+
+/**
+ * @brief Marks the highest slot that has a fixture patched to it
+ * @param slots Highest patched channel, 0 if nothing is patched
+ */
+void DMX::setPatchedLength(uint universe, uint slots) {
+    if (!active(universe))
+        return;
+    if (slots > DMX_UNIVERSE_SIZE)
+        slots = DMX_UNIVERSE_SIZE;
+    ports[universe]->patchedSlots = slots;
 }
 
-bool DMX::busy() {
-    return dmxp->busy() || /*dmxn->busy() ||*/ data_update;
+/**
+ * @brief Frames per second the universe is currently sent at
+ * @return The configured refresh rate, or lower if the current frame
+ *         length does not fit in one refresh period. 0 if not refreshed
+ */
+uint DMX::getFrameRate(uint universe) {
+    if (!active(universe) || ports[universe]->refresh_hz == 0)
+        return 0;
+    uint32_t period = 1000000 / ports[universe]->refresh_hz;
+    uint32_t length = ports[universe]->universeSize;
+    if (ports[universe]->parallel)
+        length = group->length();
+    if (DMX_FRAME_US(length) > period)
+        period = DMX_FRAME_US(length);
+    return 1000000 / period;
 }
 
-void DMX::setChannel(int channel, int value) {
-    while (dmxp->busy() /*|| dmxn->busy()*/) {
-        
+bool DMX::busy(uint universe) {
+    if (!active(universe))
+        return false;
+    if (ports[universe]->parallel)
+        return group->busy();
+    return ports[universe]->output.busy();
+}
+
+/**
+ * @brief Waits for the current frame of a universe to leave the wire
+ * @param timeout_ms Longest time to sleep waiting for the DMA interrupt
+ * @return true if the universe is idle or a new frame has already started
+ */
+bool DMX::await(uint universe, uint32_t timeout_ms) {
+    if (!active(universe))
+        return true;
+    Universe *u = ports[universe];
+
+    // Drop a notification left by a frame that finished after an earlier
+    // wait had already returned
+    ulTaskNotifyTakeIndexed(DMX_NOTIFY_INDEX, pdTRUE, 0);
+    u->waiter = xTaskGetCurrentTaskHandle();
+    bool done = !u->sending ||
+                ulTaskNotifyTakeIndexed(DMX_NOTIFY_INDEX, pdTRUE, pdMS_TO_TICKS(timeout_ms)) != 0;
+    u->waiter = nullptr;
+    if (!done)
+        return false;
+
+    // The DMA is done but the last few slots are still leaving the FIFO,
+    // at most DMX_TAIL_US. Stop early if the refresh alarm starts a frame
+    while (busy(universe) && !u->sending)
+        tight_loop_contents();
+    return true;
+}
+
+/**
+ * @brief Sets the function called at the end of every frame of a universe
+ * @param hook Called from interrupt context, nullptr to remove it
+ */
+void DMX::onFrame(uint universe, frame_hook hook, void *user_data) {
+    if (!active(universe))
+        return;
+    Universe *u = ports[universe];
+    uint32_t save = save_and_disable_interrupts();
+    u->hook_data = user_data;
+    u->hook = hook;
+    restore_interrupts(save);
+}
+
+/**
+ * @brief Takes ownership of the back buffer for writing
+ * @return The back buffer, holding the most recently written frame
+ * @post The output path will not swap until commitWrite() is called
+ */
+uint8_t *DMX::Universe::beginWrite() {
+    uint32_t save = spin_lock_blocking(swap_lock);
+    back_ready = false;
+    bool stale = back_stale;
+    back_stale = false;
+    spin_unlock(swap_lock, save);
+    if (stale) {
+        memcpy(back, front, sizeof(dmxData[0]));
+        back_highest = front_highest;
     }
-    data_update = true;
-    if (channel < 1 || channel > 512)
+    return back;
+}
+
+/**
+ * @brief Publishes the back buffer to be swapped in at the next frame
+ * @param highest Highest non-zero slot of back if the writer tracked it,
+ *        -1 to scan for it
+ */
+void DMX::Universe::commitWrite(int highest) {
+    if (highest < 0) {
+        highest = DMX_UNIVERSE_SIZE;
+        while (highest > 0 && back[highest] == 0)
+            highest--;
+    }
+    uint32_t save = spin_lock_blocking(swap_lock);
+    back_highest = highest;
+    back_ready = true;
+    spin_unlock(swap_lock, save);
+}
+
+void DMX::setChannel(uint universe, int channel, int value) {
+    if (!active(universe) || channel < 1 || channel > 512)
         return;
-    dmxData[channel] = value;
-    //ndmxData[channel] = 255 - value;
-    data_update = false;
+    uint8_t *data = ports[universe]->beginWrite();
+    data[channel] = value;
+    ports[universe]->commitWrite();
 }
 
-void DMX::unasfeSetChannel(int channel, int value) {
-    if (channel < 1 || channel > 512)
+void DMX::writeBuffer(uint universe, uint8_t *buffer, bool noStartCode) {
+    if (!active(universe))
         return;
-    dmxData[channel] = value;
-    //ndmxData[channel] = 255 - value;
+    uint8_t *data = ports[universe]->beginWrite();
+    memcpy(data + noStartCode, buffer + noStartCode, 513 - noStartCode);
+    ports[universe]->commitWrite();
 }
 
-void DMX::writeBuffer(uint8_t *buffer, bool noStartCode) {
-    while (dmxp->busy() /*|| dmxn->busy()*/) {
+uint8_t *DMX::beginFrame(uint universe) {
+    if (!active(universe))
+        return nullptr;
+    return ports[universe]->beginWrite();
+}
+
+void DMX::commitFrame(uint universe) {
+    if (!active(universe))
+        return;
+    ports[universe]->commitWrite();
+}
 
+void DMX::writeSpans(uint universe, const DmxSpan *spans, size_t count) {
+    if (!active(universe))
+        return;
+    Universe *u = ports[universe];
+    uint8_t *data = u->beginWrite();
+    int highest = u->back_highest;
+    for (size_t i = 0; i < count; i++) {
+        const DmxSpan &s = spans[i];
+        if (s.universe != universe || s.effect != 0 || s.first < 1 || s.first > DMX_UNIVERSE_SIZE)
+            continue;
+        int last = s.first + s.count - 1;
+        if (last > DMX_UNIVERSE_SIZE)
+            last = DMX_UNIVERSE_SIZE;
+        if (last < s.first)
+            continue;
+        memset(data + s.first, s.level, last - s.first + 1);
+
+        // Keep the highest non-zero slot current without rescanning
+        if (s.level != 0 && last > highest) {
+            highest = last;
+        } else if (s.level == 0 && highest >= s.first && highest <= last) {
+            highest = s.first - 1;
+            while (highest > 0 && data[highest] == 0)
+                highest--;
+        }
     }
-    data_update = true;
-    for (int i = noStartCode; i < 513; i++) {
-        dmxData[i] = buffer[i];
-        //ndmxData[i] = 255 - buffer[i];
+    u->commitWrite(highest);
+}
+
+void DMX::getshadowbuff(uint universe, uint8_t *buffer) {
+    if (!active(universe)) {
+        memset(buffer + 1, 0, 512);
+        return;
     }
-    data_update = false;
+    Universe *u = ports[universe];
+    uint32_t save = spin_lock_blocking(u->swap_lock);
+    const uint8_t *latest = u->back_stale ? u->front : u->back;
+    spin_unlock(u->swap_lock, save);
+    memcpy(buffer + 1, latest + 1, 512);
 }
 
-void DMX::unsafeWriteBuffer(uint8_t *buffer, bool noStartCode) {
-    for (int i = noStartCode; i < 513; i++) {
-        dmxData[i] = buffer[i];
-        //ndmxData[i] = 255 - buffer[i];
+/**
+ * @brief Gives the copy of a universe's curves and scale the output is not reading
+ * @return The spare, holding the live shaping, or all linear and unscaled if
+ *         there is none yet. It goes live with publishShaping()
+ */
+DMX::Shaping *DMX::editShaping(Universe *u) {
+    if (u->shapes == nullptr) {
+        u->curved = new uint8_t[sizeof(u->dmxData[0])]();
+        u->shapes = new Shaping[2]();
     }
-}
\ No newline at end of file
+    const Shaping *live = u->shape;
+    Shaping *next = live == &u->shapes[0] ? &u->shapes[1] : &u->shapes[0];
+    if (live != nullptr)
+        memcpy(next, live, sizeof(Shaping));
+    return next;
+}
+
+/**
+ * @brief Swaps in a shaping from editShaping()
+ * @post The copy it replaced is no longer read, so the next edit can reuse it
+ */
+void DMX::publishShaping(Universe *u, const Shaping *next) {
+    uint32_t save = spin_lock_blocking(u->swap_lock);
+    u->shape = next;
+    u->recurve = true;
+    spin_unlock(u->swap_lock, save);
+    settle(u);
+}
+
+/**
+ * @brief Waits out a frame being shaped with tables that were just replaced
+ * @note At most one pass over a frame, from the other core or a preempted dmx task
+ */
+void DMX::settle(Universe *u) {
+    while (u->shaping)
+        tight_loop_contents();
+}
+
+/**
+ * @brief Assigns a dimmer curve to channels first .. last of a universe
+ * @post The curve takes effect from the next frame sent
+ */
+void DMX::setCurve(uint universe, uint first, uint last, dimmer_curve curve) {
+    if (!active(universe) || curve >= CURVE_COUNT)
+        return;
+    if (first < 1)
+        first = 1;
+    if (last > DMX_UNIVERSE_SIZE)
+        last = DMX_UNIVERSE_SIZE;
+    if (first > last)
+        return;
+
+    Universe *u = ports[universe];
+    if (u->shape == nullptr && curve == CURVE_LINEAR)
+        return;
+    Shaping *next = editShaping(u);
+    memset(next->curve + first, curve, last - first + 1);
+    publishShaping(u, next);
+}
+
+dimmer_curve DMX::getCurve(uint universe, uint channel) {
+    if (!active(universe) || channel < 1 || channel > DMX_UNIVERSE_SIZE)
+        return CURVE_LINEAR;
+    const Shaping *shape = ports[universe]->shape;
+    return shape != nullptr ? (dimmer_curve)shape->curve[channel] : CURVE_LINEAR;
+}
+
+/**
+ * @brief Replaces the table of a custom curve
+ * @param index 0 .. CURVE_CUSTOM_COUNT - 1, the curve is CURVE_CUSTOM + index
+ * @return false if there is no such custom curve
+ */
+bool DMX::setCustomCurve(uint index, const uint8_t lut[256]) {
+    if (index >= CURVE_CUSTOM_COUNT)
+        return false;
+    CurveLut *next = live_luts == curve_luts[0] ? curve_luts[1] : curve_luts[0];
+    memcpy(next, live_luts, sizeof(curve_luts[0]));
+    memcpy(next[CURVE_CUSTOM + index].level, lut, 256);
+    live_luts = next;
+    for (int i = 0; i < DMX_MAX_UNIVERSES; i++) {
+        Universe *u = ports[i];
+        if (u == nullptr || u->shape == nullptr)
+            continue;
+        uint32_t save = spin_lock_blocking(u->swap_lock);
+        u->recurve = true;
+        spin_unlock(u->swap_lock, save);
+        settle(u);
+    }
+    return true;
+}
+
+/**
+ * @brief Sets the per slot scale of a universe, for grand and submasters
+ * @param scale 513 entries, start code first, or nullptr for none
+ * @post The new scale is applied whole from the next frame sent
+ */
+void DMX::setScale(uint universe, const uint8_t *scale) {
+    if (!active(universe))
+        return;
+    Universe *u = ports[universe];
+    if (scale == nullptr && (u->shape == nullptr || !u->shape->scaled))
+        return;
+    Shaping *next = editShaping(u);
+    next->scaled = scale != nullptr;
+    if (scale != nullptr)
+        memcpy(next->scale, scale, sizeof(next->scale));
+    publishShaping(u, next);
+}
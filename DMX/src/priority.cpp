@@ -0,0 +1,211 @@
+#include "priority.h"
+
+#include <string.h>
+
+/**
+ * @brief How strongly a source holds channel c: its priority plus one, 0 if it does not drive it
+ * @param address The source's per-address priority for c, used if perAddress
+ * @param priority The source's universe priority
+ * @param count Levels the source sends
+ */
+static inline uint8_t rank(bool perAddress, uint8_t address, uint8_t priority, unsigned count, unsigned c) {
+    if (c >= count || (perAddress && address == 0))
+        return 0;
+    uint8_t p = perAddress ? address : priority;
+    return (p > PRIORITY_MAX ? PRIORITY_MAX : p) + 1;
+}
+
+PriorityMerge::PriorityMerge() : _count(0), _cost(0), _changed(false) {
+    memset(_sources, 0, sizeof(_sources));
+    memset(_out, 0, sizeof(_out));
+    memset(_rank, 0, sizeof(_rank));
+    memset(_winner, PRIORITY_NONE, sizeof(_winner));
+}
+
+int PriorityMerge::claim(const uint8_t *cid, bool *fresh) {
+    int free = ERR_FULL;
+    for (unsigned s = 0; s < PRIORITY_MAX_SOURCES; s++) {
+        if (!_sources[s].active) {
+            if (free < 0)
+                free = s;
+        } else if (memcmp(_sources[s].cid, cid, PRIORITY_CID_SIZE) == 0) {
+            *fresh = false;
+            return s;
+        }
+    }
+    if (free >= 0) {
+        Source &src = _sources[free];
+        memcpy(src.cid, cid, PRIORITY_CID_SIZE);
+        src.count = 0;
+        src.perAddress = false;
+        src.active = true;
+        *fresh = true;
+    }
+    return free;
+}
+
+void PriorityMerge::levels(unsigned source, const uint8_t *levels, unsigned count, uint8_t priority,
+                           uint32_t now_ms) {
+    if (!active(source))
+        return;
+    if (count > PRIORITY_CHANNELS)
+        count = PRIORITY_CHANNELS;
+    Source &src = _sources[source];
+    unsigned was = src.count;
+    uint8_t wasPriority = src.priority;
+    unsigned span = count > was ? count : was;
+    src.count = count;                  // already in place should a channel be rescanned
+    src.priority = priority;
+    src.stamp = now_ms;
+    _cost = 0;
+    for (unsigned c = 0; c < span; c++) {
+        uint8_t level = c < count ? levels[c] : 0;
+        uint8_t before = rank(src.perAddress, src.address[c], wasPriority, was, c);
+        uint8_t after = rank(src.perAddress, src.address[c], priority, count, c);
+        if (before == after && level == src.levels[c])
+            continue;
+        src.levels[c] = level;
+        settle(source, c, after);
+    }
+    if (count != was)
+        recount();
+}
+
+void PriorityMerge::priorities(unsigned source, const uint8_t *priorities, unsigned count, uint32_t now_ms) {
+    if (!active(source))
+        return;
+    if (count > PRIORITY_CHANNELS)
+        count = PRIORITY_CHANNELS;
+    Source &src = _sources[source];
+    bool was = src.perAddress;
+    src.perAddress = true;
+    src.stamp = src.addressStamp = now_ms;
+    _cost = 0;
+    for (unsigned c = 0; c < PRIORITY_CHANNELS; c++) {
+        uint8_t address = c < count ? priorities[c] : 0;
+        uint8_t before = rank(was, src.address[c], src.priority, src.count, c);
+        uint8_t after = rank(true, address, src.priority, src.count, c);
+        src.address[c] = address;       // kept past src.count for levels that reach them later
+        if (before != after)
+            settle(source, c, after);
+    }
+}
+
+void PriorityMerge::drop(unsigned source) {
+    if (!active(source))
+        return;
+    Source &src = _sources[source];
+    src.active = false;                 // out of the running before its channels are rescanned
+    _cost = 0;
+    for (unsigned c = 0; c < src.count; c++) {
+        uint8_t before = rank(src.perAddress, src.address[c], src.priority, src.count, c);
+        src.levels[c] = 0;
+        if (before != 0)
+            settle(source, c, 0);
+    }
+    src.count = 0;
+    recount();
+}
+
+void PriorityMerge::expire(uint32_t now_ms, uint32_t timeout_ms) {
+    for (unsigned s = 0; s < PRIORITY_MAX_SOURCES; s++) {
+        Source &src = _sources[s];
+        if (!src.active)
+            continue;
+        if (now_ms - src.stamp > timeout_ms) {
+            drop(s);
+        } else if (src.perAddress && now_ms - src.addressStamp > timeout_ms) {
+            _cost = 0;
+            src.perAddress = false;
+            for (unsigned c = 0; c < src.count; c++) {
+                uint8_t before = rank(true, src.address[c], src.priority, src.count, c);
+                uint8_t after = rank(false, src.address[c], src.priority, src.count, c);
+                if (before != after)
+                    settle(s, c, after);
+            }
+        }
+    }
+}
+
+uint8_t PriorityMerge::priority() const {
+    uint8_t highest = 0;
+    for (unsigned s = 0; s < PRIORITY_MAX_SOURCES; s++) {
+        if (_sources[s].active && _sources[s].priority > highest)
+            highest = _sources[s].priority;
+    }
+    return highest;
+}
+
+unsigned PriorityMerge::sources() const {
+    unsigned n = 0;
+    for (unsigned s = 0; s < PRIORITY_MAX_SOURCES; s++)
+        n += _sources[s].active;
+    return n;
+}
+
+bool PriorityMerge::changed() {
+    bool was = _changed;
+    _changed = false;
+    return was;
+}
+
+/**
+ * @brief Arbitrates channel c again after one source's level or rank for it moved
+ * @param source The source that moved, its new level already stored
+ * @param after Its rank for c now
+ * @post _winner[c] is a highest ranked source with the highest level among those ranked as high
+ */
+void PriorityMerge::settle(unsigned source, unsigned c, uint8_t after) {
+    uint8_t level = _sources[source].levels[c];
+    uint8_t out = _out[c];
+    _cost++;
+    if (after > _rank[c]) {
+        _rank[c] = after;
+        _winner[c] = source;
+        _out[c] = level;
+    } else if (_winner[c] != source) {
+        // The winner is unchanged unless this source joins it and goes higher
+        if (after == _rank[c] && after != 0 && level > out) {
+            _winner[c] = source;
+            _out[c] = level;
+        }
+    } else if (after == _rank[c] && level >= out) {
+        _out[c] = level;
+    } else {
+        rescan(c);                      // the winner lost ground, someone else may be ahead now
+    }
+    _changed |= _out[c] != out;
+}
+
+/**
+ * @brief Finds the winner of channel c among every source
+ */
+void PriorityMerge::rescan(unsigned c) {
+    uint8_t best = 0;
+    uint8_t level = 0;
+    uint8_t winner = PRIORITY_NONE;
+    for (unsigned s = 0; s < PRIORITY_MAX_SOURCES; s++) {
+        const Source &src = _sources[s];
+        if (!src.active)
+            continue;
+        uint8_t r = rank(src.perAddress, src.address[c], src.priority, src.count, c);
+        if (r > best || (r == best && r != 0 && src.levels[c] > level)) {
+            best = r;
+            level = src.levels[c];
+            winner = s;
+        }
+    }
+    _rank[c] = best;
+    _winner[c] = winner;
+    _out[c] = level;
+}
+
+void PriorityMerge::recount() {
+    uint16_t count = 0;
+    for (unsigned s = 0; s < PRIORITY_MAX_SOURCES; s++) {
+        if (_sources[s].active && _sources[s].count > count)
+            count = _sources[s].count;
+    }
+    _changed |= count != _count;
+    _count = count;
+}
@@ -0,0 +1,67 @@
+#include "undo.h"
+
+UndoRing::UndoRing() : _floor(0), _open(0), _write(0), _oldest(0), _done(0), _newest(0), _applying{0, 0},
+                       _reverse(false), _overflow(false) {
+}
+
+void UndoRing::record(uint8_t universe, uint16_t channel, bool ownedBefore, uint8_t before, bool ownedAfter,
+                      uint8_t after) {
+    if (_overflow || (ownedBefore == ownedAfter && (before == after || !ownedAfter)))
+        return;
+    if (_write == _open && _done < _newest) {
+        // A new command after an undo: what was undone can no longer be redone
+        _newest = _done;
+        _write = _open = _done > _oldest ? at(_done - 1).end : _floor;
+    }
+    while (_write - _floor >= UNDO_DELTAS) {
+        if (_oldest == _newest) {
+            // This command alone fills the ring
+            _overflow = true;
+            return;
+        }
+        _floor = at(_oldest++).end;
+    }
+    UndoDelta &d = _deltas[_write++ % UNDO_DELTAS];
+    d.where = (channel & 0x3FF) | (universe & 0x7) << 10 | ownedBefore << 13 | ownedAfter << 14;
+    d.before = before;
+    d.after = after;
+}
+
+void UndoRing::commit() {
+    if (_overflow) {
+        _oldest = _done = _newest;
+        _floor = _open = _write;
+        _overflow = false;
+        return;
+    }
+    if (_write == _open)
+        return;
+    if (_newest - _oldest == UNDO_STEPS)
+        _floor = at(_oldest++).end;
+    at(_newest++) = {_open, _write};
+    _done = _newest;
+    _open = _write;
+}
+
+size_t UndoRing::undo() {
+    commit();
+    if (_done == _oldest)
+        return 0;
+    _applying = at(--_done);
+    _reverse = true;
+    return _applying.end - _applying.start;
+}
+
+size_t UndoRing::redo() {
+    commit();
+    if (_done == _newest)
+        return 0;
+    _applying = at(_done++);
+    _reverse = false;
+    return _applying.end - _applying.start;
+}
+
+const UndoDelta &UndoRing::delta(size_t i) const {
+    uint32_t d = _reverse ? _applying.end - 1 - i : _applying.start + i;
+    return _deltas[d % UNDO_DELTAS];
+}
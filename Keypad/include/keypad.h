@@ -0,0 +1,121 @@
+#ifndef _keypad_h_
+#define _keypad_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define KEY_PROGRAM_SIZE 64
+#define KEY_MAX_CHANNEL 512
+#define KEY_MAX_LEVEL 255
+#define KEY_MAX_UNIVERSE 8
+#define KEY_MAX_TIME 9999       // tenths of a second
+#define KEY_MAX_CUE 999
+
+/*
+    Parses a keypad command line ("001 THRU 010 AND 020 AT 128") into a
+    fixed size selection/level program. Parsing never allocates, never
+    modifies the command line and runs in a single pass over the input.
+
+    THRU ranges are folded into a single SELECT instruction, so
+    "1 THRU 512 AT 50" compiles to exactly two instructions.
+
+    A level may be followed by TIME and a fade time in seconds with up
+    to one decimal ("001 THRU 012 AT 050 TIME 2.5"), which is stored on
+    the LEVEL instruction in tenths of a second.
+
+    A selection may run an effect instead of taking a level: CHASE,
+    SINE, TRIANGLE, SQUARE or FLICKER, optionally followed by a peak
+    level (full if left out) and TIME with the period of one cycle
+    ("001 THRU 012 SINE 200 TIME 2"). STOP ends the effects on the
+    selection ("001 THRU 012 STOP").
+
+    Channels may be prefixed with a universe as "universe/channel"
+    ("2/001 THRU 024 AT FULL"). Universes are numbered from 1 on the
+    keypad and from 0 in the program; an unprefixed channel is in
+    universe 1, and a THRU range cannot cross universes.
+*/
+class KeyProgram {
+    public:
+    enum opcode : uint8_t {
+        // Add channels first..last of universe to the pending selection
+        OP_SELECT = 0,
+        // Set every pending channel to level, fading over time if it is
+        // not 0, and clear the selection
+        OP_LEVEL,
+        // Zero the frame and drop every captured channel
+        OP_RELEASE,
+        // Run effect on every pending channel, peaking at level with a
+        // period of time (0 for the default), and clear the selection
+        OP_EFFECT,
+        // Store the output as cue first
+        OP_RECORD,
+        // Load cue first into the base layer
+        OP_RECALL,
+        // Load the cue after the last one recalled
+        OP_GO,
+        // Put back the levels before the last command
+        OP_UNDO,
+        // Put back the levels of the last command undone
+        OP_REDO,
+    };
+
+    enum effect : uint8_t {
+        EFFECT_STOP = 0,
+        EFFECT_CHASE,
+        EFFECT_SINE,
+        EFFECT_TRIANGLE,
+        EFFECT_SQUARE,
+        EFFECT_FLICKER
+    };
+
+    struct instr {
+        uint8_t op;
+        uint8_t level;
+        uint8_t universe;
+        uint8_t effect;     // OP_EFFECT
+        uint16_t first;     // or the cue number of OP_RECORD and OP_RECALL
+        uint16_t last;
+        uint16_t time;      // OP_LEVEL fade time or OP_EFFECT period in tenths of a second
+    };
+
+    enum return_code {
+        SUCCESS = 0,
+
+        // The command needs more than KEY_PROGRAM_SIZE instructions
+        ERR_PROGRAM_FULL = -1,
+
+        // A token is not a number or a known keyword, TIME does not
+        // follow a level or an effect, RECORD or RECALL has no number,
+        // or a token follows RELEASE, GO, UNDO, REDO or a cue number
+        ERR_BAD_TOKEN = -2,
+
+        // A channel number is outside 1..KEY_MAX_CHANNEL, a universe is
+        // outside 1..KEY_MAX_UNIVERSE or a THRU range crosses universes
+        ERR_BAD_CHANNEL = -3,
+
+        // A cue number is outside 1..KEY_MAX_CUE
+        ERR_BAD_CUE = -4
+    };
+
+    KeyProgram() : _size(0) {};
+
+    /*
+        Compile a command line. keys does not need to be NUL terminated,
+        parsing stops at length or at the first NUL. On failure the
+        program is left empty.
+    */
+    return_code parse(const char *keys, size_t length);
+
+    size_t size() const {return _size;};
+    const instr &operator[](size_t i) const {return _code[i];};
+    const instr *begin() const {return _code;};
+    const instr *end() const {return _code + _size;};
+
+    private:
+    bool emit(uint8_t op, uint8_t level, uint16_t first, uint16_t last, uint8_t universe = 0);
+
+    instr _code[KEY_PROGRAM_SIZE];
+    size_t _size;
+};
+
+#endif // _keypad_h_
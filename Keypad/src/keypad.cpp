@@ -0,0 +1,228 @@
+#include "keypad.h"
+
+/**
+ * @brief Case insensitive compare of a token against an upper case keyword
+ * @param token Start of the token, not NUL terminated
+ * @param len Length of the token
+ * @param word Upper case keyword
+ * @return true if the token is exactly the keyword
+ */
+static bool keyword(const char *token, size_t len, const char *word) {
+    size_t i = 0;
+    for (; i < len && word[i]; i++) {
+        if ((token[i] & ~0x20) != word[i])
+            return false;
+    }
+    return i == len && word[i] == '\0';
+}
+
+bool KeyProgram::emit(uint8_t op, uint8_t level, uint16_t first, uint16_t last, uint8_t universe) {
+    if (_size >= KEY_PROGRAM_SIZE)
+        return false;
+    instr &in = _code[_size++];
+    in.op = op;
+    in.level = level;
+    in.universe = universe;
+    in.effect = 0;
+    in.first = first;
+    in.last = last;
+    in.time = 0;
+    return true;
+}
+
+/**
+ * @brief Reads a fade time of whole seconds with an optional tenth
+ * @param token Start of the token, not NUL terminated
+ * @param len Length of the token
+ * @param tenths Set to the time in tenths of a second, clamped to KEY_MAX_TIME
+ * @return false if the token is not of the form 3, 3. or 2.5
+ */
+static bool fadeTime(const char *token, size_t len, uint16_t &tenths) {
+    uint32_t value = 0;
+    size_t i = 0;
+    for (; i < len && token[i] >= '0' && token[i] <= '9'; i++) {
+        if (value <= KEY_MAX_TIME)
+            value = value * 10 + (token[i] - '0');
+    }
+    if (i == 0)
+        return false;
+    value *= 10;
+    if (i < len && token[i] == '.') {
+        i++;
+        if (i < len && token[i] >= '0' && token[i] <= '9')
+            value += token[i++] - '0';
+    }
+    if (i != len)
+        return false;
+    tenths = value > KEY_MAX_TIME ? KEY_MAX_TIME : value;
+    return true;
+}
+
+// Effect keywords, indexed by KeyProgram::effect
+static const char *const effectWords[] = {"STOP", "CHASE", "SINE", "TRIANGLE", "SQUARE", "FLICKER"};
+
+/**
+ * @brief Matches a token against the effect keywords
+ * @param effect Set to the KeyProgram::effect of the keyword
+ * @return true if the token names an effect or STOP
+ */
+static bool effectKeyword(const char *token, size_t len, uint8_t &effect) {
+    for (size_t i = 0; i < sizeof(effectWords) / sizeof(effectWords[0]); i++) {
+        if (keyword(token, len, effectWords[i])) {
+            effect = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+KeyProgram::return_code KeyProgram::parse(const char *keys, size_t length) {
+    bool isLEVEL = false;
+    bool isEFFECT = false;      // the last token was an effect, a number after it is its peak level
+    bool isTHRU = false;
+    bool isTIME = false;
+    bool isCUE = false;         // RECORD or RECALL waits for its cue number
+    bool isEND = false;         // the command is complete, any further token is an error
+    return_code status = SUCCESS;
+    size_t pos = 0;
+    _size = 0;
+
+    while (pos < length && keys[pos] != '\0' && status == SUCCESS) {
+        if (keys[pos] == ' ' || keys[pos] == '\t' || keys[pos] == '\n' || keys[pos] == '\r') {
+            pos++;
+            continue;
+        }
+        if (isEND) {
+            status = ERR_BAD_TOKEN;
+            break;
+        }
+        const char *t = keys + pos;
+        size_t len = 0;
+        while (pos < length && keys[pos] > ' ') {
+            pos++;
+            len++;
+        }
+        bool effectOpen = isEFFECT;
+        isEFFECT = false;
+        uint8_t effect;
+
+        if (isTIME) {
+            // TIME always directly follows the LEVEL or effect it belongs to
+            if (!fadeTime(t, len, _code[_size - 1].time))
+                status = ERR_BAD_TOKEN;
+            isTIME = false;
+        } else if (isCUE) {
+            uint32_t value = 0;
+            size_t i = 0;
+            for (; i < len && t[i] >= '0' && t[i] <= '9'; i++) {
+                if (value <= KEY_MAX_CUE)
+                    value = value * 10 + (t[i] - '0');
+            }
+            if (i == 0 || i != len)
+                status = ERR_BAD_TOKEN;
+            else if (value < 1 || value > KEY_MAX_CUE)
+                status = ERR_BAD_CUE;
+            else
+                _code[_size - 1].first = value;
+            isCUE = false;
+            isEND = true;
+        } else if (t[0] >= '0' && t[0] <= '9') {
+            // number, or universe/number
+            uint32_t value = 0;
+            uint32_t universe = 0;
+            bool hasUniverse = false;
+            for (size_t i = 0; i < len; i++) {
+                if (t[i] == '/' && !hasUniverse && i > 0 && i + 1 < len) {
+                    hasUniverse = true;
+                    universe = value;
+                    value = 0;
+                    continue;
+                }
+                if (t[i] < '0' || t[i] > '9') {
+                    status = ERR_BAD_TOKEN;
+                    break;
+                }
+                if (value <= 0xFFFF)
+                    value = value * 10 + (t[i] - '0');
+            }
+            if (status != SUCCESS)
+                break;
+
+            if (effectOpen) {
+                if (hasUniverse)
+                    status = ERR_BAD_TOKEN;
+                else
+                    _code[_size - 1].level = value > KEY_MAX_LEVEL ? KEY_MAX_LEVEL : value;
+            } else if (isLEVEL) {
+                if (hasUniverse)
+                    status = ERR_BAD_TOKEN;
+                else if (!emit(OP_LEVEL, value > KEY_MAX_LEVEL ? KEY_MAX_LEVEL : value, 0, 0))
+                    status = ERR_PROGRAM_FULL;
+                isLEVEL = false;
+            } else if (value < 1 || value > KEY_MAX_CHANNEL) {
+                status = ERR_BAD_CHANNEL;
+            } else if (hasUniverse && (universe < 1 || universe > KEY_MAX_UNIVERSE)) {
+                status = ERR_BAD_CHANNEL;
+            } else if (isTHRU && _size > 0 && _code[_size - 1].op == OP_SELECT) {
+                // Extend the previous selection instead of emitting one channel per step
+                instr &sel = _code[_size - 1];
+                if (hasUniverse && universe - 1 != sel.universe)
+                    status = ERR_BAD_CHANNEL;
+                else if (value < sel.first)
+                    sel.first = value;
+                else
+                    sel.last = value;
+                isTHRU = false;
+            } else {
+                if (!emit(OP_SELECT, 0, value, value, hasUniverse ? universe - 1 : 0))
+                    status = ERR_PROGRAM_FULL;
+                isTHRU = false;
+            }
+        } else if (effectKeyword(t, len, effect)) {
+            // Takes the pending selection like a level does, at full unless a level follows
+            if (isLEVEL)
+                status = ERR_BAD_TOKEN;
+            else if (!emit(OP_EFFECT, effect == EFFECT_STOP ? 0 : KEY_MAX_LEVEL, 0, 0))
+                status = ERR_PROGRAM_FULL;
+            else
+                _code[_size - 1].effect = effect;
+            isEFFECT = effect != EFFECT_STOP;
+        } else if (keyword(t, len, "RELEASE")) {
+            if (!emit(OP_RELEASE, 0, 0, 0))
+                status = ERR_PROGRAM_FULL;
+            isEND = true;
+        } else if (keyword(t, len, "RECORD") || keyword(t, len, "RECALL")) {
+            if (!emit(keyword(t, len, "RECORD") ? OP_RECORD : OP_RECALL, 0, 0, 0))
+                status = ERR_PROGRAM_FULL;
+            isCUE = true;
+        } else if (keyword(t, len, "GO") || keyword(t, len, "UNDO") || keyword(t, len, "REDO")) {
+            uint8_t op = keyword(t, len, "GO") ? OP_GO : keyword(t, len, "UNDO") ? OP_UNDO : OP_REDO;
+            if (!emit(op, 0, 0, 0))
+                status = ERR_PROGRAM_FULL;
+            isEND = true;
+        } else if (keyword(t, len, "AND")) {
+            continue;
+        } else if (keyword(t, len, "AT")) {
+            isLEVEL = true;
+        } else if (keyword(t, len, "FULL")) {
+            if (!emit(OP_LEVEL, KEY_MAX_LEVEL, 0, 0))
+                status = ERR_PROGRAM_FULL;
+            isLEVEL = false;
+        } else if (keyword(t, len, "THRU")) {
+            isTHRU = true;
+        } else if (keyword(t, len, "TIME")) {
+            if (isLEVEL || _size == 0 ||
+                (_code[_size - 1].op != OP_LEVEL && _code[_size - 1].op != OP_EFFECT))
+                status = ERR_BAD_TOKEN;
+            isTIME = true;
+        } else {
+            status = ERR_BAD_TOKEN;
+        }
+    }
+
+    if ((isTIME || isCUE) && status == SUCCESS)
+        status = ERR_BAD_TOKEN;
+    if (status != SUCCESS)
+        _size = 0;
+    return status;
+}
@@ -0,0 +1,176 @@
+#include "artnet.h"
+
+#include <string.h>
+
+#include "hardware/sync.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include "pico/cyw43_arch.h"
+
+static const char artnetId[8] = "Art-Net";
+
+ArtNetNode::ArtNetNode() : _pcb(nullptr), _first(0), _count(0), _name(""), _notify(nullptr), _arg(nullptr),
+                           _replyIp(0), _packets(0), _polls(0), _late(0), _ignored(0) {
+    memset(_frames, 0, sizeof(_frames));
+    memset(_sequence, 0, sizeof(_sequence));
+}
+
+/**
+ * @brief Starts listening on ARTNET_PORT
+ * @param first The Port-Address received into keypad universe 1
+ * @param count Universes to receive
+ * @param name Short name reported in ArtPollReply, kept by reference
+ * @param notify Called when a frame is waiting, may be nullptr
+ * @param arg Passed to notify
+ */
+ArtNetNode::return_code ArtNetNode::begin(uint16_t first, uint8_t count, const char *name, notify_fn notify,
+                                          void *arg) {
+    if (count == 0 || count > ARTNET_MAX_UNIVERSES || first > 0x7FFF || (first & 0x0F) + count > 16)
+        return ERR_BAD_UNIVERSE;
+    spin_lock_t *lock = spin_lock_instance(next_striped_spin_lock_num());
+    for (uint8_t u = 0; u < count; u++) {
+        if (_frames[u] == nullptr)
+            _frames[u] = new Mailbox<NetFrame>(lock);
+    }
+    _first = first;
+    _name = name;
+    _notify = notify;
+    _arg = arg;
+    _count = count;
+
+    cyw43_arch_lwip_begin();
+    build();
+    _pcb = udp_new();
+    if (_pcb == nullptr) {
+        cyw43_arch_lwip_end();
+        return ERR_NO_PCB;
+    }
+    if (udp_bind(_pcb, IP_ANY_TYPE, ARTNET_PORT) != ERR_OK) {
+        udp_remove(_pcb);
+        _pcb = nullptr;
+        cyw43_arch_lwip_end();
+        return ERR_BIND;
+    }
+    udp_recv(_pcb, received, this);
+    cyw43_arch_lwip_end();
+    return SUCCESS;
+}
+
+/**
+ * @brief Builds one ArtPollReply per four ports for the current address
+ */
+void ArtNetNode::build() {
+    struct netif *n = netif_default;
+    _replyIp = n != nullptr ? ip4_addr_get_u32(netif_ip4_addr(n)) : 0;
+    for (unsigned r = 0; r * ARTNET_PORTS_PER_REPLY < _count; r++) {
+        uint8_t *b = _replies[r];
+        memset(b, 0, ARTNET_REPLY_SIZE);
+        memcpy(b, artnetId, sizeof(artnetId));
+        b[8] = ARTNET_OP_POLL_REPLY & 0xFF;
+        b[9] = ARTNET_OP_POLL_REPLY >> 8;
+        memcpy(b + 10, &_replyIp, 4);                   // already in network order
+        b[14] = ARTNET_PORT & 0xFF;
+        b[15] = ARTNET_PORT >> 8;
+        b[17] = 1;                                      // firmware version
+        b[18] = (_first >> 8) & 0x7F;                   // Net
+        b[19] = (_first >> 4) & 0x0F;                   // Sub-Net
+        b[21] = 0xFF;                                   // OEM unknown
+        b[23] = 0xC0;                                   // indicators normal
+        b[24] = 0xF0;                                   // ESTA 0x7FF0, prototype
+        b[25] = 0x7F;
+        strncpy((char *)b + 26, _name, 17);
+        strncpy((char *)b + 44, "Remote Focus Unit", 63);
+        strncpy((char *)b + 108, "#0001 [0000] OK", 63);
+
+        unsigned ports = _count - r * ARTNET_PORTS_PER_REPLY;
+        if (ports > ARTNET_PORTS_PER_REPLY)
+            ports = ARTNET_PORTS_PER_REPLY;
+        b[173] = ports;
+        for (unsigned i = 0; i < ports; i++) {
+            b[174 + i] = 0x80;                          // outputs DMX512
+            b[182 + i] = 0x80;                          // and is sending
+            b[190 + i] = (_first + r * ARTNET_PORTS_PER_REPLY + i) & 0x0F;
+        }
+        if (n != nullptr)
+            memcpy(b + 201, n->hwaddr, 6);
+        memcpy(b + 207, &_replyIp, 4);                  // bound to this node
+        b[211] = r + 1;                                 // bind index
+        b[212] = 0x0B;                                  // web configuration, DHCP capable, 15 bit Port-Address
+    }
+}
+
+/**
+ * @brief Sends the prebuilt replies to whoever polled, without copying them
+ */
+void ArtNetNode::reply(const ip_addr_t *addr) {
+    struct netif *n = netif_default;
+    if (n != nullptr && ip4_addr_get_u32(netif_ip4_addr(n)) != _replyIp)
+        build();
+    for (unsigned r = 0; r * ARTNET_PORTS_PER_REPLY < _count; r++) {
+        struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, ARTNET_REPLY_SIZE, PBUF_REF);
+        if (p == nullptr)
+            return;
+        p->payload = _replies[r];
+        udp_sendto(_pcb, p, addr, ARTNET_PORT);
+        pbuf_free(p);
+    }
+}
+
+void ArtNetNode::received(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, uint16_t port) {
+    ((ArtNetNode *)arg)->receive(p, addr);
+    pbuf_free(p);
+}
+
+void ArtNetNode::receive(struct pbuf *p, const ip_addr_t *addr) {
+    uint8_t buffer[ARTNET_DMX_DATA];
+    uint16_t length = p->tot_len < ARTNET_DMX_DATA ? p->tot_len : ARTNET_DMX_DATA;
+    const uint8_t *h = nullptr;
+    if (length >= ARTNET_OPCODE + 2)
+        h = (const uint8_t *)pbuf_get_contiguous(p, buffer, sizeof(buffer), length, 0);
+    if (h == nullptr || memcmp(h, artnetId, sizeof(artnetId)) != 0) {
+        _ignored++;
+        return;
+    }
+    uint16_t op = h[ARTNET_OPCODE] | h[ARTNET_OPCODE + 1] << 8;
+    if (op == ARTNET_OP_DMX && length == ARTNET_DMX_DATA) {
+        dmx(p, h);
+    } else if (op == ARTNET_OP_POLL) {
+        _polls++;
+        reply(addr);
+    } else {
+        _ignored++;
+    }
+}
+
+/**
+ * @brief Publishes the levels of one ArtDmx packet
+ * @param h The packet header, ARTNET_DMX_DATA bytes
+ * @post The levels are copied once, from the pbuf into the mailbox slot
+ */
+void ArtNetNode::dmx(struct pbuf *p, const uint8_t *h) {
+    uint16_t u = (h[ARTNET_DMX_PORT_ADDRESS] | h[ARTNET_DMX_PORT_ADDRESS + 1] << 8) - _first;
+    uint16_t length = h[ARTNET_DMX_LENGTH] << 8 | h[ARTNET_DMX_LENGTH + 1];
+    if (u >= _count || length < 2 || length > NET_CHANNELS || p->tot_len < ARTNET_DMX_DATA + length) {
+        _ignored++;
+        return;
+    }
+
+    // Sequence 0 means the sender does not number its packets
+    uint8_t sequence = h[ARTNET_DMX_SEQUENCE];
+    int8_t ahead = sequence - _sequence[u];
+    if (sequence != 0 && _sequence[u] != 0 && ahead <= 0 && ahead > -20) {
+        _late++;
+        return;
+    }
+    _sequence[u] = sequence;
+    _packets++;
+
+    NetFrame *frame = _frames[u]->writeSlot();
+    frame->priority = NET_PRIORITY_DEFAULT;
+    frame->count = length;
+    frame->levels[0] = 0;
+    pbuf_copy_partial(p, frame->levels + 1, length, ARTNET_DMX_DATA);
+    if (!_frames[u]->publish() && _notify != nullptr)
+        _notify(_arg);                  // a superseded frame already woke the reader
+}
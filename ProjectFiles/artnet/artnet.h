@@ -0,0 +1,107 @@
+#ifndef _artnet_h_
+#define _artnet_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lwip/ip_addr.h"
+#include "mailbox.h"
+#include "netframe.h"
+
+#define ARTNET_PORT 6454
+#define ARTNET_MAX_UNIVERSES 8
+#define ARTNET_PORTS_PER_REPLY 4        // ports one ArtPollReply describes
+#define ARTNET_MAX_REPLIES ((ARTNET_MAX_UNIVERSES + ARTNET_PORTS_PER_REPLY - 1) / ARTNET_PORTS_PER_REPLY)
+#define ARTNET_REPLY_SIZE 239
+#define ARTNET_VERSION 14
+
+// OpCodes, sent little endian
+#define ARTNET_OP_POLL 0x2000
+#define ARTNET_OP_POLL_REPLY 0x2100
+#define ARTNET_OP_DMX 0x5000
+
+// Offsets into an ArtDmx packet
+#define ARTNET_OPCODE 8
+#define ARTNET_DMX_SEQUENCE 12
+#define ARTNET_DMX_PORT_ADDRESS 14      // SubUni then Net, so little endian
+#define ARTNET_DMX_LENGTH 16            // big endian
+#define ARTNET_DMX_DATA 18
+
+/*
+    An Art-Net 4 node with up to ARTNET_MAX_UNIVERSES output ports, the
+    15 bit Port-Addresses first .. first + count - 1 landing in keypad
+    universes 0 .. count - 1.
+
+    ArtPollReply packets are built once in begin(), one per four ports,
+    and sent straight from that buffer for each ArtPoll; only a change
+    of IP address rebuilds them. An ArtDmx packet finds its universe by
+    subtracting first from its Port-Address and its levels are copied
+    once, from the pbuf into the universe's mailbox slot, as sACN does.
+*/
+class ArtNetNode {
+    public:
+    enum return_code {
+        SUCCESS = 0,
+
+        // lwIP has no UDP PCB to spare
+        ERR_NO_PCB = -1,
+
+        // The port is taken
+        ERR_BIND = -2,
+
+        // count is 0 or above ARTNET_MAX_UNIVERSES, or the ports would
+        // not share one Net and Sub-Net
+        ERR_BAD_UNIVERSE = -3
+    };
+
+    // Called in the lwIP thread when a frame is published to an empty mailbox
+    typedef void (*notify_fn)(void *arg);
+
+    ArtNetNode();
+
+    /*
+        Starts the node. name is reported as the short name, up to 17
+        characters. Every port shares the Net and Sub-Net of first.
+    */
+    return_code begin(uint16_t first, uint8_t count, const char *name, notify_fn notify, void *arg);
+
+    /*
+        The newest frame of keypad universe u, or nullptr if none arrived
+        since the last call. Stays valid until the next call for u that
+        returns a frame.
+    */
+    NetFrame *latest(uint8_t u) {return u < _count ? _frames[u]->latest() : nullptr;};
+    uint16_t first() const {return _first;};
+    uint8_t count() const {return _count;};
+
+    uint32_t packets() const {return _packets;};
+    uint32_t polls() const {return _polls;};
+    // Packets dropped for arriving out of order
+    uint32_t late() const {return _late;};
+    // Packets that are not Art-Net, or ArtDmx for another Port-Address
+    uint32_t ignored() const {return _ignored;};
+
+    private:
+    static void received(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, uint16_t port);
+    void receive(struct pbuf *p, const ip_addr_t *addr);
+    void dmx(struct pbuf *p, const uint8_t *h);
+    void reply(const ip_addr_t *addr);
+    void build();
+
+    struct udp_pcb *_pcb;
+    uint16_t _first;
+    uint8_t _count;
+    const char *_name;
+    notify_fn _notify;
+    void *_arg;
+    Mailbox<NetFrame> *_frames[ARTNET_MAX_UNIVERSES];
+    uint8_t _sequence[ARTNET_MAX_UNIVERSES];
+    uint8_t _replies[ARTNET_MAX_REPLIES][ARTNET_REPLY_SIZE];
+    uint32_t _replyIp;              // the address the replies were built for
+    uint32_t _packets;
+    uint32_t _polls;
+    uint32_t _late;
+    uint32_t _ignored;
+};
+
+#endif // _artnet_h_
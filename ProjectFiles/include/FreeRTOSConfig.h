@@ -59,6 +59,9 @@
 #define configUSE_COUNTING_SEMAPHORES           1
 #define configQUEUE_REGISTRY_SIZE               8
 #define configUSE_QUEUE_SETS                    1
+// Index 0 is used by stream buffers, the DMX engine wakes waiters on index 1
+// and main.cpp rings dmx_task on index 2
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES   3
 #define configUSE_TIME_SLICING                  1
 #define configUSE_NEWLIB_REENTRANT              0
 // todo need this for lwip FreeRTOS sys_arch to compile
@@ -40,6 +40,9 @@
 #define LWIP_IPV4                   1
 #define LWIP_TCP                    1
 #define LWIP_UDP                    1
+#define LWIP_IGMP                   1       // sACN multicast
+#define MEMP_NUM_IGMP_GROUP         10
+#define MEMP_NUM_UDP_PCB            8
 #define LWIP_DNS                    1
 #define LWIP_TCP_KEEPALIVE          1
 #define LWIP_NETIF_TX_SINGLE_PBUF   1
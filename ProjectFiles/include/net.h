@@ -2,7 +2,13 @@
 // All rights reserved
 #pragma once
 
+#include "dmxinputs.h"
+#include "keypad.h"
+#include "masters.h"
 #include "mongoose.h"
+#include "patch.h"
+#include "piodmx.h"
+#include "sacn.h"
 
 #if !defined(HTTP_URL)
 #define HTTP_URL "http://0.0.0.0:8000"
@@ -13,6 +19,15 @@
 #endif
 
 void web_init(struct mg_mgr *mgr);
+
+// Defined in main.cpp
+extern DMX dmx;
+extern DmxInputs inputs;
+extern MasterBank masters;
+extern PatchTable patch;
+extern SacnReceiver sacn;
+KeyProgram::return_code processKeys(const char* keys, size_t keysLength, bool* queued);
+void publishPatch();
 // Copyright (c) 2023 Cesanta Software Limited
 // All rights reserved
 
@@ -164,13 +179,61 @@ static size_t print_int_arr(void (*out)(char, void *), void *ptr, va_list *ap) {
   return len;
 }
 
+// Effective frame length and rate of every universe, which shrink and
+// rise with the highest slot in use
+static size_t print_dmx_stats(void (*out)(char, void *), void *ptr, va_list *ap) {
+  size_t len = 0;
+  for (uint u = 0; u < dmx.universes(); u++) {
+    if (!dmx.active(u)) continue;
+    len += mg_xprintf(out, ptr, "%s{%m:%u,%m:%u,%m:%u}",       //
+                      len == 0 ? "" : ",",                     //
+                      MG_ESC("universe"), u + 1,               //
+                      MG_ESC("slots"), dmx.getFrameLength(u),  //
+                      MG_ESC("rate"), dmx.getFrameRate(u));
+  }
+  (void) ap;
+  return len;
+}
+
+// sACN sources being merged and what the last packet cost to merge
+static size_t print_sacn_stats(void (*out)(char, void *), void *ptr, va_list *ap) {
+  (void) ap;
+  return mg_xprintf(out, ptr, "%m:%u,%m:%lu,%m:%lu,%m:%lu,%m:%u,%m:%lu,%m:%lu",  //
+                    MG_ESC("sources"), sacn.sources(),                            //
+                    MG_ESC("packets"), (unsigned long) sacn.packets(),            //
+                    MG_ESC("late"), (unsigned long) sacn.late(),                  //
+                    MG_ESC("ignored"), (unsigned long) sacn.ignored(),            //
+                    MG_ESC("mergeChannels"), (unsigned) sacn.mergeChannels(),     //
+                    MG_ESC("mergeMicros"), (unsigned long) sacn.mergeMicros(),    //
+                    MG_ESC("mergePeakMicros"), (unsigned long) sacn.mergePeakMicros());
+}
+
+// Frames received per DMX input, and how many were short of 512 slots
+static size_t print_input_stats(void (*out)(char, void *), void *ptr, va_list *ap) {
+  size_t len = 0;
+  for (unsigned i = 0; i < DMX_MAX_INPUTS; i++) {
+    if (!inputs.active(i)) continue;
+    len += mg_xprintf(out, ptr, "%s{%m:%u,%m:%lu,%m:%lu,%m:%s}",                  //
+                      len == 0 ? "" : ",",                                       //
+                      MG_ESC("input"), i + 1,                                    //
+                      MG_ESC("frames"), (unsigned long) inputs.received(i),      //
+                      MG_ESC("short"), (unsigned long) inputs.shortFrames(i),    //
+                      MG_ESC("breakDetect"), inputs.detecting(i) ? "true" : "false");
+  }
+  (void) ap;
+  return len;
+}
+
 static void handle_stats_get(struct mg_connection *c) {
   int points[] = {21, 22, 22, 19, 18, 20, 23, 23, 22, 22, 22, 23, 22};
-  mg_http_reply(c, 200, s_json_header, "{%m:%d,%m:%d,%m:[%M]}",
+  mg_http_reply(c, 200, s_json_header, "{%m:%d,%m:%d,%m:[%M],%m:[%M],%m:[%M],%m:{%M}}",
                 MG_ESC("temperature"), 21,  //
                 MG_ESC("humidity"), 67,     //
                 MG_ESC("points"), print_int_arr,
-                sizeof(points) / sizeof(points[0]), points);
+                sizeof(points) / sizeof(points[0]), points,
+                MG_ESC("dmx"), print_dmx_stats,
+                MG_ESC("inputs"), print_input_stats,
+                MG_ESC("sacn"), print_sacn_stats);
 }
 
 static size_t print_events(void (*out)(char, void *), void *ptr, va_list *ap) {
@@ -220,6 +283,238 @@ static void handle_settings_get(struct mg_connection *c) {
                 MG_ESC("device_name"), MG_ESC(s_settings.device_name));
 }
 
+// Runs a keypad command line, {"keys": "001 THRU 010 AT FULL"}. The
+// command is parsed in place inside the request body
+static void handle_keys(struct mg_connection *c, struct mg_str body) {
+  int len = 0;
+  int off = mg_json_get(body, "$.keys", &len);
+  if (off < 0 || len < 2 || body.ptr[off] != '"') {
+    mg_http_reply(c, 400, s_json_header, "{%m:%m}", MG_ESC("error"),
+                  MG_ESC("No keys provided"));
+    return;
+  }
+  static const char *const errors[] = {
+      "",  // by -KeyProgram::return_code
+      "Command is too long", "Unknown or misplaced key",
+      "Channel or universe out of range", "Cue out of range"};
+  bool queued = false;
+  KeyProgram::return_code status = processKeys(body.ptr + off + 1, len - 2, &queued);
+  if (status != KeyProgram::SUCCESS) {
+    mg_http_reply(c, 400, s_json_header, "{%m:%m}", MG_ESC("error"),
+                  MG_ESC(errors[-status]));
+    return;
+  }
+  if (!queued) {
+    mg_http_reply(c, 503, s_json_header, "{%m:%m}", MG_ESC("error"),
+                  MG_ESC("DMX output is busy, try again"));
+    return;
+  }
+  mg_http_reply(c, 200, s_json_header, "{%m:%s}", MG_ESC("status"), "true");
+}
+
+static size_t print_universes(void (*out)(char, void *), void *ptr, va_list *ap) {
+  size_t len = 0;
+  for (uint u = 0; u < dmx.universes(); u++) {
+    if (!dmx.active(u)) continue;
+    len += mg_xprintf(out, ptr, "%s{%m:%u,%m:%u,%m:%u,%m:%u,%m:%u}",  //
+                      len == 0 ? "" : ",",                             //
+                      MG_ESC("universe"), u + 1,                       //
+                      MG_ESC("pin"), dmx.getPin(u),                    //
+                      MG_ESC("length"), dmx.getLength(u),              //
+                      MG_ESC("min_length"), dmx.getMinLength(u),       //
+                      MG_ESC("refresh"), dmx.getRefreshRate(u));
+  }
+  (void) ap;
+  return len;
+}
+
+static void handle_universes_get(struct mg_connection *c) {
+  mg_http_reply(c, 200, s_json_header, "[%M]", print_universes);
+}
+
+// Applies live, {"universe": 1, "refresh": 40, "length": 512, "min_length": 24}.
+// length caps the frame, min_length is the shortest frame sent. refresh only
+// applies to a universe refreshed continuously (its refresh is not 0); the
+// request is refused, changing nothing, if it is sent for any other
+static void handle_universes_set(struct mg_connection *c, struct mg_str body) {
+  long u = mg_json_get_long(body, "$.universe", 0) - 1;
+  long refresh = mg_json_get_long(body, "$.refresh", 0);
+  const char *error = NULL;
+  if (u < 0 || !dmx.active(u)) {
+    error = "No such universe";
+  } else if (refresh > 0 && dmx.getRefreshRate(u) == 0) {
+    error = "Universe is not refreshed continuously";
+  } else {
+    long length = mg_json_get_long(body, "$.length", 0);
+    long min_length = mg_json_get_long(body, "$.min_length", 0);
+    if (refresh > 0) dmx.setRefreshRate(u, refresh);
+    if (length > 0) dmx.setLength(u, length);
+    if (min_length > 0) dmx.setMinLength(u, min_length);
+  }
+  bool ok = error == NULL;
+  mg_http_reply(c, ok ? 200 : 400, s_json_header,
+                "{%m:%s,%m:%m}",                          //
+                MG_ESC("status"), ok ? "true" : "false",  //
+                MG_ESC("message"), MG_ESC(ok ? "Success" : error));
+}
+
+// Assigns a dimmer curve to a channel range, {"universe": 1, "first": 1,
+// "last": 24, "curve": 1}. Curves are 0 linear, 1 square, 2 inverse square,
+// 3 s-curve and 4 onwards custom
+static void handle_curves_set(struct mg_connection *c, struct mg_str body) {
+  long u = mg_json_get_long(body, "$.universe", 0) - 1;
+  long first = mg_json_get_long(body, "$.first", 1);
+  long last = mg_json_get_long(body, "$.last", first);
+  long curve = mg_json_get_long(body, "$.curve", -1);
+  bool ok = u >= 0 && dmx.active(u) && curve >= 0 && curve < CURVE_COUNT &&
+            first >= 1 && last >= first && last <= DMX_UNIVERSE_SIZE;
+  if (ok) dmx.setCurve(u, first, last, (dimmer_curve) curve);
+  mg_http_reply(c, ok ? 200 : 400, s_json_header,
+                "{%m:%s,%m:%m}",                          //
+                MG_ESC("status"), ok ? "true" : "false",  //
+                MG_ESC("message"), MG_ESC(ok ? "Success" : "Bad curve or range"));
+}
+
+// Loads a custom curve, {"custom": 0, "lut": [0, 1, ... 255]}, the output
+// level for each of the 256 input levels
+static void handle_curves_custom(struct mg_connection *c, struct mg_str body) {
+  long index = mg_json_get_long(body, "$.custom", -1);
+  uint8_t lut[256];
+  bool ok = index >= 0 && index < CURVE_CUSTOM_COUNT;
+  for (int i = 0; ok && i < 256; i++) {
+    char path[16];
+    mg_snprintf(path, sizeof(path), "$.lut[%d]", i);
+    long level = mg_json_get_long(body, path, -1);
+    ok = level >= 0 && level <= 255;
+    lut[i] = (uint8_t) level;
+  }
+  if (ok) dmx.setCustomCurve(index, lut);
+  mg_http_reply(c, ok ? 200 : 400, s_json_header,
+                "{%m:%s,%m:%m}",                          //
+                MG_ESC("status"), ok ? "true" : "false",  //
+                MG_ESC("message"), MG_ESC(ok ? "Success" : "Bad custom curve"));
+}
+
+static size_t print_master_levels(void (*out)(char, void *), void *ptr, va_list *ap) {
+  size_t len = 0;
+  for (unsigned s = 0; s < MASTER_SUBMASTERS; s++)
+    len += mg_xprintf(out, ptr, "%s%u", s == 0 ? "" : ",", masters.level(s));
+  (void) ap;
+  return len;
+}
+
+// Grand and submasters, levels 0-255. {"grand": 128} sets the grandmaster,
+// {"sub": 1, "level": 64} a submaster. {"sub": 1, "universe": 1, "first": 1,
+// "last": 24} adds output slots, as patched, to a submaster and "clear": true
+// empties it first.
+// Replies with every level; a fader move rebuilds only the scale tables of
+// the universes it affects
+static void handle_master(struct mg_connection *c, struct mg_str body) {
+  static uint8_t scale[DMX_UNIVERSE_SIZE + 1];
+  bool ok = true;
+  long grand = mg_json_get_long(body, "$.grand", -1);
+  if (grand >= 0) {
+    ok = grand <= MASTER_FULL;
+    if (ok) masters.setGrand(grand);
+  }
+  long sub = mg_json_get_long(body, "$.sub", 0) - 1;
+  if (ok && sub >= 0) {
+    long level = mg_json_get_long(body, "$.level", -1);
+    long u = mg_json_get_long(body, "$.universe", 0) - 1;
+    bool clear = false;
+    mg_json_get_bool(body, "$.clear", &clear);
+    ok = sub < MASTER_SUBMASTERS && level <= MASTER_FULL;
+    if (ok && clear) masters.clear(sub);
+    if (ok && level >= 0) masters.setLevel(sub, level);
+    if (ok && u >= 0) {
+      long first = mg_json_get_long(body, "$.first", 1);
+      long last = mg_json_get_long(body, "$.last", first);
+      ok = masters.assign(sub, u, first, last) == MasterBank::SUCCESS;
+    }
+  }
+  for (uint u = 0; u < dmx.universes(); u++) {
+    if (!(masters.stale() & (1u << u))) continue;
+    bool scaled = masters.build(u, scale);
+    dmx.setScale(u, scaled ? scale : NULL);
+  }
+  mg_http_reply(c, ok ? 200 : 400, s_json_header, "{%m:%s,%m:%u,%m:[%M]}",  //
+                MG_ESC("status"), ok ? "true" : "false",                  //
+                MG_ESC("grand"), masters.grand(),                         //
+                MG_ESC("subs"), print_master_levels);
+}
+
+static size_t print_patch(void (*out)(char, void *), void *ptr, va_list *ap) {
+  size_t len = 0;
+  for (size_t i = 0; i < patch.size(); i++) {
+    const PatchRun &r = patch[i];
+    bool input = r.src_universe >= PATCH_MAX_UNIVERSES;
+    len += mg_xprintf(out, ptr, "%s{%m:%u,%m:%u,%m:%u,%m:%u,%m:%u}",  //
+                      i == 0 ? "" : ",",                               //
+                      MG_ESC(input ? "input" : "universe"),            //
+                      input ? r.src_universe - PATCH_INPUT(0) + 1 : r.src_universe + 1,  //
+                      MG_ESC("channel"), r.src_first,                  //
+                      MG_ESC("count"), r.count,                        //
+                      MG_ESC("out_universe"), r.dst_universe + 1,      //
+                      MG_ESC("address"), r.dst_first);
+  }
+  (void) ap;
+  return len;
+}
+
+static void handle_patch_get(struct mg_connection *c) {
+  mg_http_reply(c, 200, s_json_header, "[%M]", print_patch);
+}
+
+// Replaces the whole patch, {"patch": [{"universe": 1, "channel": 1,
+// "count": 12, "out_universe": 1, "address": 101}, ...]}. Keypad channel
+// universe/channel onwards is sent on address onwards of out_universe; a
+// channel may appear in several entries. An entry with "input": n in place
+// of "universe" routes DMX input n instead of keypad channels. Takes effect
+// on the next frame. {"identity": true} restores 1:1
+static void handle_patch_set(struct mg_connection *c, struct mg_str body) {
+  static PatchTable table;
+  bool identity = false;
+  mg_json_get_bool(body, "$.identity", &identity);
+  bool ok = true;
+  table.clear();
+  if (identity) {
+    table.identity(dmx.universes());
+  } else {
+    for (int i = 0; ok && i <= PATCH_MAX_RUNS; i++) {
+      char path[40];
+      int len = 0;
+      mg_snprintf(path, sizeof(path), "$.patch[%d]", i);
+      if (mg_json_get(body, path, &len) < 0) break;
+      mg_snprintf(path, sizeof(path), "$.patch[%d].input", i);
+      long input = mg_json_get_long(body, path, 0);
+      long v[5] = {0};
+      const char *keys[] = {"universe", "channel", "count", "out_universe", "address"};
+      for (int k = input > 0 ? 1 : 0; k < 5; k++) {
+        mg_snprintf(path, sizeof(path), "$.patch[%d].%s", i, keys[k]);
+        v[k] = mg_json_get_long(body, path, 0);
+        ok = ok && v[k] >= 1 && v[k] <= DMX_UNIVERSE_SIZE;
+      }
+      ok = ok && v[3] <= PATCH_MAX_UNIVERSES;  // before it narrows to uint8_t
+      if (input > 0)
+        ok = ok && input <= PATCH_MAX_INPUTS &&
+             table.route(input - 1, v[1], v[2], v[3] - 1, v[4]) == PatchTable::SUCCESS;
+      else
+        ok = ok && input == 0 && v[0] <= PATCH_MAX_UNIVERSES &&
+             table.add(v[0] - 1, v[1], v[2], v[3] - 1, v[4]) == PatchTable::SUCCESS;
+    }
+  }
+  if (ok) {
+    patch = table;
+    for (uint u = 0; u < dmx.universes(); u++)
+      dmx.setPatchedLength(u, identity ? 0 : patch.highest(u));
+    publishPatch();
+  }
+  mg_http_reply(c, ok ? 200 : 400, s_json_header,
+                "{%m:%s,%m:%m}",                          //
+                MG_ESC("status"), ok ? "true" : "false",  //
+                MG_ESC("message"), MG_ESC(ok ? "Success" : "Bad patch entry"));
+}
+
 // HTTP request handler function
 static void fn(struct mg_connection *c, int ev, void *ev_data) {
     void* fn_data = NULL;
@@ -246,6 +541,22 @@ static void fn(struct mg_connection *c, int ev, void *ev_data) {
       handle_settings_get(c);
     } else if (mg_http_match_uri(hm, "/api/settings/set")) {
       handle_settings_set(c, hm->body);
+    } else if (mg_http_match_uri(hm, "/api/keys")) {
+      handle_keys(c, hm->body);
+    } else if (mg_http_match_uri(hm, "/api/universes/get")) {
+      handle_universes_get(c);
+    } else if (mg_http_match_uri(hm, "/api/universes/set")) {
+      handle_universes_set(c, hm->body);
+    } else if (mg_http_match_uri(hm, "/api/curves/set")) {
+      handle_curves_set(c, hm->body);
+    } else if (mg_http_match_uri(hm, "/api/curves/custom")) {
+      handle_curves_custom(c, hm->body);
+    } else if (mg_http_match_uri(hm, "/api/patch/get")) {
+      handle_patch_get(c);
+    } else if (mg_http_match_uri(hm, "/api/patch/set")) {
+      handle_patch_set(c, hm->body);
+    } else if (mg_http_match_uri(hm, "/api/master")) {
+      handle_master(c, hm->body);
     } else {
       struct mg_http_serve_opts opts;
       memset(&opts, 0, sizeof(opts));
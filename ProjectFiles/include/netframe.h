@@ -0,0 +1,19 @@
+#ifndef _netframe_h_
+#define _netframe_h_
+
+#include <stdint.h>
+
+#define NET_CHANNELS 512
+#define NET_PRIORITY_DEFAULT 100        // sACN's default, given to sources without a priority
+
+/*
+    One universe as received from the network, handed from the lwIP
+    thread to dmx_task through a Mailbox.
+*/
+struct NetFrame {
+    uint16_t count;                     // levels after the start code, 0 once the source stopped
+    uint8_t priority;
+    uint8_t levels[NET_CHANNELS + 1];   // levels[0] is the start code
+};
+
+#endif // _netframe_h_
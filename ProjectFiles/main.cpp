@@ -12,11 +12,11 @@
 #include <array>
 #include <cstring>
 #include <map>
-#include <set>
 #include <utility>
 #include <vector>
 
 #include "EEPROM.h"
+#include "artnet.h"
 //#include "core_json.h"
 #include "dhcpserver.h"
 #include "dnsserver.h"
@@ -25,7 +25,20 @@
 #include "pico/cyw43_arch.h"
 #include "pico/stdlib.h"
 #include "pico/util/datetime.h"
+#include "chanset.h"
+#include "cues.h"
+#include "dmxinputs.h"
+#include "effects.h"
+#include "fade.h"
+#include "keypad.h"
+#include "layers.h"
+#include "mailbox.h"
+#include "masters.h"
+#include "merge.h"
+#include "patch.h"
 #include "piodmx.h"
+#include "sacn.h"
+#include "undo.h"
 
 // default config values
 static EEPROMClass eeprom;
@@ -81,107 +94,415 @@ static ip4_addr_t gw, mask;
 static dhcp_server_t dhcp;
 static dns_server_t dns;
 static QueueHandle_t tcpQueue = NULL;
-static QueueHandle_t dmxQueue = NULL;
-static std::set<uint16_t> captured;
+static QueueHandle_t dmxSpans = NULL;
+static TaskHandle_t dmxTask = NULL;                             // rung on DMX_WAKE_NOTIFY_INDEX
+static LayerStack* layers[DMX_MAX_UNIVERSES];                   // level sources of each active universe
+static uint8_t logical[DMX_MAX_UNIVERSES][DMX_UNIVERSE_SIZE + 1];  // composed levels by keypad channel, before the patch
+static Mailbox<PatchMap>* patchMaps;                            // compiled patches on their way to dmx_task
 
-static DMX dmx;
+static const uint dmx_pins[] = {2};                             // output pin for each universe, universe 1 first
+#define DMX_PARALLEL_PORTS 0                                    // >0 sends that many universes from dmx_pins[0] up on one state machine
+static const uint dmx_in_pins[] = {3};                          // receive pin for each DMX input, input 1 first
+static_assert(sizeof(dmx_in_pins) / sizeof(dmx_in_pins[0]) <= DMX_MAX_INPUTS && DMX_MAX_INPUTS <= PATCH_MAX_INPUTS,
+              "every DMX input needs a patch source");
+#define DMX_SPAN_QUEUE 256                                      // channel spans waiting for dmx_task, a command makes at most 72
+#define DMX_WAKE_NOTIFY_INDEX 2                                 // doorbell for network, input and patch wakes, they take no queue space
+#define DMX_FADE_TICK_MS 10                                     // fades and effects are stepped this often while any is running
+DMX dmx;
+MasterBank masters;                                             // scales what is sent, changed from /api/master
+PatchTable patch;                                               // keypad channels to DMX addresses, changed from /api/patch/set
+static FadeEngine fades;
+static EffectEngine effects;
+static CueStore cues;                                           // looks in flash above the EEPROM sector
+static uint16_t currentCue = 0;                                 // last cue recalled, GO moves on from it
+static UndoRing history;                                        // manual layer changes of recent keypad commands
+SacnReceiver sacn;                                              // merged sACN sources, counted in /api/stats/get
+static ArtNetNode artnet;
+DmxInputs inputs;                                               // physical DMX in, routed to outputs by the patch, counted in /api/stats/get
+#define SACN_FIRST_UNIVERSE 1                                   // sACN universe received into keypad universe 1
+#define ARTNET_FIRST_UNIVERSE 0                                 // Art-Net Port-Address received into keypad universe 1
+#define NET_SOURCE_SACN 0                                       // sources of each networkMerge
+#define NET_SOURCE_ARTNET 1
+#define NET_SOURCES 2
+static SourceMerge* networkMerge[DMX_MAX_UNIVERSES];            // sACN and Art-Net frames of each universe, merged HTP
+static uint16_t networkCount[DMX_MAX_UNIVERSES];                // channels each universe's network layer holds
 
-void dmx_loop(void *pvParameters) {
-    TickType_t xLastWakeTime = xTaskGetTickCount();
-    while (1) {
-        vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(16));
-        if (dmx.busy()) {
+/**
+ * @brief Starts or stops effects on the effects layer for one keypad span
+ * @param stack The layers of span.universe
+ * @param span Channels, span.effect to run on them peaking at span.level with a
+ *        period of span.time, or EFFECT_STOP
+ */
+static void applyEffect(LayerStack& stack, const DmxSpan& span) {
+    uint last = span.first + span.count - 1;
+    if (last > DMX_UNIVERSE_SIZE)
+        last = DMX_UNIVERSE_SIZE;
+    EffectEngine::return_code status;
+    if (span.effect == EFFECT_STOP) {
+        status = effects.stop(span.universe, span.first, last);
+        if (status == EffectEngine::SUCCESS)
+            stack.release(LayerStack::LAYER_EFFECTS, span.first, span.count);
+    } else {
+        status = effects.start(span.universe, span.first, last, (effect_wave)span.effect, span.level,
+                               span.time * 100);
+        if (status == EffectEngine::SUCCESS)
+            stack.fill(LayerStack::LAYER_EFFECTS, span.first, span.count, 0);   // claimed dark, the next step lights them
+    }
+    if (status != EffectEngine::SUCCESS)                        // nothing changed, what ran there runs on
+        printf("Effect on universe %u failed: %d\n", span.universe + 1, status);
+}
+
+/**
+ * @brief Applies one keypad channel span to the manual or effects layer of its universe
+ * @param stack The layers of span.universe
+ * @param frame The current levels of span.universe before the patch, where new fades start from
+ * @param span Levels to snap to, to fade to if span.time is set, or to release
+ */
+static void applySpan(LayerStack& stack, const uint8_t* frame, const DmxSpan& span) {
+    if (span.first < 1 || span.first > DMX_UNIVERSE_SIZE)
+        return;
+    if (span.effect != EFFECT_NONE) {
+        applyEffect(stack, span);
+        return;
+    }
+    fades.cancel(span.universe, span.first, span.count);        // a new level or release overrides a running fade
+    uint last = span.first + span.count - 1;
+    if (last > DMX_UNIVERSE_SIZE)
+        last = DMX_UNIVERSE_SIZE;
+    const ChannelSet& owned = stack.owned(LayerStack::LAYER_MANUAL);
+    for (uint ch = span.first; ch <= last; ch++)                // a fade is remembered at the level it ends on
+        history.record(span.universe, ch, owned.test(ch), stack.level(LayerStack::LAYER_MANUAL, ch),
+                       span.time != DMX_SPAN_RELEASE, span.level);
+    if (span.time == DMX_SPAN_RELEASE) {
+        stack.release(LayerStack::LAYER_MANUAL, span.first, span.count);
+        return;
+    }
+    if (span.time == 0) {
+        stack.fill(LayerStack::LAYER_MANUAL, span.first, span.count, span.level);
+        return;
+    }
+    for (uint ch = span.first; ch <= last; ch++) {
+        uint8_t from = frame[ch];
+        if (stack.owned(LayerStack::LAYER_MANUAL).test(ch))
+            from = stack.level(LayerStack::LAYER_MANUAL, ch);
+        if (fades.start(span.universe, ch, from, span.level, span.time * 100) == FadeEngine::SUCCESS)
+            stack.set(LayerStack::LAYER_MANUAL, ch, from);      // capture the channel where it is, then fade it
+        else
+            stack.set(LayerStack::LAYER_MANUAL, ch, span.level);    // no slot left, snap rather than freeze at from
+    }
+}
+
+/**
+ * @brief Records or recalls a cue
+ * @param span A DMX_SPAN_RECORD or DMX_SPAN_RECALL span, span.first the cue number
+ * @param sources The composed levels of each universe, what is recorded
+ * @return The universes whose layers changed
+ * @post A recalled cue replaces the base layer of every universe, read straight from flash
+ */
+static uint32_t applyCue(const DmxSpan& span, const uint8_t* const sources[DMX_MAX_UNIVERSES]) {
+    if (span.time == DMX_SPAN_RECORD) {
+        for (uint u = 0; u < DMX_MAX_UNIVERSES; u++) {
+            if (layers[u] != NULL)
+                layers[u]->compose(logical[u]);                 // include spans queued ahead of the record
+        }
+        CueStore::return_code status = cues.record(span.first, sources);  // output stalls while flash is written
+        if (status != CueStore::SUCCESS)
+            printf("Recording cue %u failed: %d\n", span.first, status);
+        return 0;
+    }
+    uint16_t number = span.first != 0 ? span.first : cues.next(currentCue);
+    const CueHeader* cue = cues.find(number);
+    if (cue == NULL)
+        return 0;
+    currentCue = number;
+    for (uint u = 0; u < DMX_MAX_UNIVERSES; u++) {
+        if (layers[u] != NULL)
+            layers[u]->releaseAll(LayerStack::LAYER_BASE);
+    }
+    const uint8_t* at = cue->look();
+    while (const LookRun* run = look_next(at, cue->look() + cue->length)) {
+        if (layers[run->universe] != NULL)
+            layers[run->universe]->load(LayerStack::LAYER_BASE, run->first, run->levels(), run->count);  // one copy per run
+    }
+    return ~0u;
+}
+
+/**
+ * @brief Undoes or redoes one keypad command
+ * @param span A DMX_SPAN_UNDO or DMX_SPAN_REDO span
+ * @return The universes whose manual layer changed
+ * @post Channels land on the recorded levels, fades running on them are stopped
+ */
+static uint32_t applyHistory(const DmxSpan& span) {
+    bool undo = span.time == DMX_SPAN_UNDO;
+    size_t count = undo ? history.undo() : history.redo();
+    uint32_t touched = 0;
+    for (size_t i = 0; i < count; i++) {
+        const UndoDelta& d = history.delta(i);
+        if (layers[d.universe()] == NULL)
+            continue;
+        fades.cancel(d.universe(), d.channel(), 1);
+        if (undo ? d.ownedBefore() : d.ownedAfter())
+            layers[d.universe()]->set(LayerStack::LAYER_MANUAL, d.channel(), undo ? d.before : d.after);
+        else
+            layers[d.universe()]->release(LayerStack::LAYER_MANUAL, d.channel(), 1);
+        touched |= 1u << d.universe();
+    }
+    return touched;
+}
+
+/**
+ * @brief Merges the newest sACN and Art-Net frames of each universe into its network layer
+ * @param now The current tick count, to drop sources that stopped sending
+ * @return The universes whose network layer changed
+ * @post A universe sent both ways takes the higher level of each channel, as Art-Net merges
+ */
+static uint32_t applyNetwork(TickType_t now) {
+    uint32_t touched = 0;
+    uint32_t now_ms = now * portTICK_PERIOD_MS;
+    NetFrame* received[SACN_MAX_UNIVERSES] = {NULL};
+    sacn.collect(received);                                     // universes released by one sync packet arrive together
+    for (uint u = 0; u < DMX_MAX_UNIVERSES; u++) {
+        const NetFrame* frames[NET_SOURCES] = {u < SACN_MAX_UNIVERSES ? received[u] : NULL,   // by NET_SOURCE_
+                                               artnet.latest(u)};
+        SourceMerge* merge = networkMerge[u];
+        if (merge == NULL)
             continue;
+        uint32_t was = merge->sources();
+        bool fresh = false;
+        for (uint s = 0; s < NET_SOURCES; s++) {
+            if (frames[s] == NULL)
+                continue;
+            if (frames[s]->count > 0)
+                merge->update(s, frames[s]->levels + 1, frames[s]->count, now_ms);
+            else
+                merge->drop(s);                                 // every source of the protocol stopped
+            fresh = true;
         }
-        dmx.sendDMX();
+        merge->expire(now_ms, SACN_TIMEOUT_MS);                 // a protocol gone quiet lets go of its channels
+        if (!fresh && merge->sources() == was)
+            continue;
+        uint count = merge->count();
+        merge->merge();
+        if (count < networkCount[u])
+            layers[u]->release(LayerStack::LAYER_NETWORK, count + 1, networkCount[u] - count);
+        if (count > 0)
+            layers[u]->load(LayerStack::LAYER_NETWORK, 1, merge->output(), count);     // marks only levels that moved
+        networkCount[u] = count;
+        touched |= 1u << u;
     }
+    return touched;
+}
+
+/**
+ * @brief Wakes dmx_task for a waiting network frame, patch or keypad command, never blocks
+ */
+static void wakeDmx(void*) {
+    if (dmxTask != NULL)                                        // wifi_init_task rings once dmx_task exists
+        xTaskNotifyGiveIndexed(dmxTask, DMX_WAKE_NOTIFY_INDEX);
+}
+
+/**
+ * @brief Wakes dmx_task for a received DMX input frame, runs in the DMA interrupt
+ */
+static void wakeDmxFromISR(void*) {
+    if (dmxTask == NULL)
+        return;
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveIndexedFromISR(dmxTask, DMX_WAKE_NOTIFY_INDEX, &woken);
+    portYIELD_FROM_ISR(woken);
 }
 
 void dmx_task(void* pvParameters) {
     if (rfu_config.dmx_loop)
-        xTaskCreate(dmx_loop, "dmx_loop", 2048, NULL, 3, NULL);
-    uint8_t zero[512];
-    memset(zero, 0, 512);
-    xQueueSend(dmxQueue, zero, 0);
+        for (uint u = 0; u < dmx.universes(); u++)
+            dmx.startRefresh(u);                                // frames are paced by a hardware alarm from here on
+    DmxSpan spans[KEY_PROGRAM_SIZE];
+    uint8_t* manual[DMX_MAX_UNIVERSES] = {NULL};
+    ChannelSet* manualDirty[DMX_MAX_UNIVERSES] = {NULL};
+    uint8_t* effect[DMX_MAX_UNIVERSES] = {NULL};
+    ChannelSet* effectDirty[DMX_MAX_UNIVERSES] = {NULL};
+    const uint8_t* sources[PATCH_MAX_SOURCES] = {NULL};        // keypad universes, then DMX inputs
+    for (uint u = 0; u < DMX_MAX_UNIVERSES; u++) {
+        if (layers[u] != NULL) {
+            manual[u] = layers[u]->levels(LayerStack::LAYER_MANUAL);
+            manualDirty[u] = &layers[u]->dirty(LayerStack::LAYER_MANUAL);
+            effect[u] = layers[u]->levels(LayerStack::LAYER_EFFECTS);
+            effectDirty[u] = &layers[u]->dirty(LayerStack::LAYER_EFFECTS);
+            sources[u] = logical[u];
+        }
+    }
+    const PatchMap* map = NULL;
+    TickType_t lastStep = xTaskGetTickCount();
     while (1) {
-        uint8_t data[512];
-        xQueueReceive(dmxQueue, data, portMAX_DELAY);
-        while (dmx.busy()) {
-            vTaskDelay(1);
+        size_t count = 0;
+        bool network = false;
+        for (uint u = 0; u < DMX_MAX_UNIVERSES; u++)
+            network |= networkCount[u] != 0;
+        TickType_t wait = uxQueueMessagesWaiting(dmxSpans) > 0 ? 0    // spans left over from the last pass
+                        : fades.active() || effects.active() ? pdMS_TO_TICKS(DMX_FADE_TICK_MS)
+                        : network ? pdMS_TO_TICKS(SACN_TIMEOUT_MS)    // wakes to notice a source stopping
+                        : portMAX_DELAY;
+        ulTaskNotifyTakeIndexed(DMX_WAKE_NOTIFY_INDEX, pdTRUE, wait);
+        while (count < KEY_PROGRAM_SIZE && xQueueReceive(dmxSpans, &spans[count], 0) == pdTRUE)
+            count++;                                            // coalesce everything already queued into one update
+
+        uint32_t touched = fades.universes() | effects.universes();
+        for (size_t i = 0; i < count; i++)
+            touched |= 1u << spans[i].universe;
+        const PatchMap* repatch = patchMaps->latest();
+        if (repatch != NULL) {
+            map = repatch;                                      // stays valid until the next latest()
+            touched = ~0u;                                      // every address may have moved
+        }
+
+        TickType_t now = xTaskGetTickCount();
+        uint32_t elapsed = (now - lastStep) * portTICK_PERIOD_MS;
+        fades.step(elapsed, manual, manualDirty);               // running fades first, so new ones start from 0ms
+        effects.step(elapsed, effect, effectDirty);             // only channels whose level moved are marked dirty
+        lastStep = now;
+        touched |= applyNetwork(now);
+        for (uint i = 0; i < DMX_MAX_INPUTS; i++) {
+            const uint8_t* frame = inputs.latest(i);
+            if (frame != NULL) {
+                sources[PATCH_INPUT(i)] = frame;                // stays valid until a newer frame is taken
+                touched |= 1u << PATCH_INPUT(i);                // only its routes are copied again
+            }
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (spans[i].time == DMX_SPAN_COMMIT)
+                history.commit();                               // the spans before it were one command
+            else if (spans[i].time == DMX_SPAN_UNDO || spans[i].time == DMX_SPAN_REDO)
+                touched |= applyHistory(spans[i]);
+            else if (spans[i].time == DMX_SPAN_RECORD || spans[i].time == DMX_SPAN_RECALL)
+                touched |= applyCue(spans[i], sources);         // in queue order, so a GO lands in this frame
+            else if (spans[i].universe < DMX_MAX_UNIVERSES && layers[spans[i].universe] != NULL)
+                applySpan(*layers[spans[i].universe], logical[spans[i].universe], spans[i]);
+        }
+        for (uint u = 0; u < DMX_MAX_UNIVERSES; u++) {
+            if ((touched & (1u << u)) && layers[u] != NULL)
+                layers[u]->compose(logical[u]);                 // only channels some layer changed are recomputed
+        }
+        if (map == NULL)
+            continue;
+
+        uint8_t* frames[DMX_MAX_UNIVERSES] = {NULL};
+        uint32_t outputs = repatch != NULL ? ~0u : map->targets(touched);
+        for (uint u = 0; u < dmx.universes(); u++) {
+            if (!(outputs & (1u << u)) || !dmx.active(u))
+                continue;
+            frames[u] = dmx.beginFrame(u);                      // written in place, swapped in at the next frame boundary
+            if (repatch != NULL)
+                memset(frames[u] + 1, 0, DMX_UNIVERSE_SIZE);    // addresses no longer patched go dark
+        }
+        map->scatter(touched, sources, frames);                 // one memcpy per patch run
+
+        uint32_t ready = 0;
+        for (uint u = 0; u < dmx.universes(); u++) {
+            if (frames[u] == NULL)
+                continue;
+            dmx.commitFrame(u);
+            ready |= 1u << u;
+        }
+        if (!rfu_config.dmx_loop && ready != 0) {
+            for (uint u = 0; u < dmx.universes(); u++)
+                if (ready & (1u << u))
+                    dmx.await(u, 50);                           // sleeps until the DMA interrupt, a full frame is 23ms
+            dmx.sendTogether(ready);                            // every break starts within microseconds
         }
-        dmx.forceBusy(true);
-        dmx.unsafeWriteBuffer(data);
-        dmx.forceBusy(false);
-        if (!rfu_config.dmx_loop)
-            dmx.sendDMX();
     }
 }
 
 /**
- * @brief Dechiphers the key string and generates a DMX frame to be sent
+ * @brief Compiles the patch table and hands it to dmx_task
+ * @post dmx_task resends every universe through the new patch
+ */
+void publishPatch() {
+    patch.compile(*patchMaps->writeSlot());
+    patchMaps->publish();
+    wakeDmx(NULL);
+}
+
+/**
+ * @brief Dechiphers the key string and generates the channel changes to be sent
  * @param keys The key string buffer to be parsed
  * @param keysLength The length of the key string
- * @post The dmxQueue is populated with the DMX frame to be sent
+ * @param queued Set when the command reached dmx_task, false if dmxSpans had no room for all of it
+ * @return KeyProgram::SUCCESS, or why the keys do not parse
+ * @post One span per selected range is queued to dmxSpans, so the cost follows
+ *       the channels touched rather than the universe size. Never blocks the caller
  */
-void processKeys(char* keys, size_t keysLength) {
-    char* token;
-    std::vector<char*> tokens;
-    std::vector<uint16_t> channels;
-    bool isLEVEL = false;
-    bool isTHRU = false;
-    uint8_t dmxFrame[512];
-    memset(dmxFrame, 0, 512);
-    dmx.getshadowbuff(dmxFrame);
-
-    token = strtok(keys, " ");
-    while (token != nullptr) {
-        tokens.push_back(token);
-        token = strtok(NULL, " ");
-    }
-    for (const auto& t : tokens) {
-        if (strncmp(t, "release", 7) == 0) {
-            memset(dmxFrame, 0, 512);
-            captured.clear();
-            break;
-        } else if (strncmp(t, "AND", 3) == 0) {
-            continue;
-        } else if (strncmp(t, "AT", 2) == 0) {
-            isLEVEL = true;
-            continue;
-        } else if (strncmp(t, "FULL", 4) == 0) {
-            for (auto d : channels) {
-                dmxFrame[d] = 255;
+KeyProgram::return_code processKeys(const char* keys, size_t keysLength, bool* queued) {
+    static const effect_wave effectWaves[] = {EFFECT_STOP, EFFECT_CHASE, EFFECT_SINE,  // by KeyProgram::effect
+                                              EFFECT_TRIANGLE, EFFECT_SQUARE, EFFECT_FLICKER};
+    *queued = false;
+    KeyProgram program;
+    KeyProgram::return_code status = program.parse(keys, keysLength);
+    if (status != KeyProgram::SUCCESS)
+        return status;
+
+    DmxSpan spans[KEY_PROGRAM_SIZE + DMX_MAX_UNIVERSES + 1];
+    size_t count = 0;
+    size_t selected = 0;                                        // spans from here on are still waiting for a level
+    for (const KeyProgram::instr& in : program) {
+        if (in.op == KeyProgram::OP_SELECT) {
+            DmxSpan& span = spans[count++];
+            span.first = in.first;
+            span.count = in.last - in.first + 1;
+            span.universe = in.universe;
+            span.level = 0;
+            span.time = 0;
+            span.effect = EFFECT_NONE;
+        } else if (in.op == KeyProgram::OP_LEVEL) {
+            for (; selected < count; selected++) {
+                spans[selected].level = in.level;
+                spans[selected].time = in.time;
             }
-            captured.insert(channels.begin(), channels.end());
-            channels.clear();
-            isLEVEL = false;
-            continue;
-        } else if (strncmp(t, "THRU", 4) == 0) {
-            isTHRU = true;
-        } else {
-            if (isLEVEL) {
-                uint16_t level = atoi(t);
-                for (auto d : channels) {
-                    dmxFrame[d] = level;
-                }
-                captured.insert(channels.begin(), channels.end());
-                channels.clear();
-                isLEVEL = false;
-            } else if (isTHRU) {
-                uint16_t channel = atoi(t);
-                if (channel >= 1 && channel <= 512)
-                    for (int i = channels.back() + 1; i <= channel; i++) {
-                        channels.push_back(i);
-                    }
-
-                isTHRU = false;
-            } else {
-                uint16_t channel = atoi(t);
-                channels.push_back(channel);
+        } else if (in.op == KeyProgram::OP_EFFECT) {
+            for (; selected < count; selected++) {
+                spans[selected].level = in.level;
+                spans[selected].time = in.time;
+                spans[selected].effect = effectWaves[in.effect];
+            }
+        } else if (in.op == KeyProgram::OP_RELEASE) {
+            count = selected;
+            for (uint u = 0; u < dmx.universes(); u++) {
+                DmxSpan& span = spans[count++];
+                span.first = 1;
+                span.count = DMX_UNIVERSE_SIZE;
+                span.universe = u;
+                span.level = 0;
+                span.time = DMX_SPAN_RELEASE;                   // drop the manual levels, lower layers show through
+                span.effect = EFFECT_NONE;
             }
+            selected = count;
+        } else if (in.op >= KeyProgram::OP_RECORD && in.op <= KeyProgram::OP_REDO) {
+            static const uint16_t times[] = {DMX_SPAN_RECORD, DMX_SPAN_RECALL, DMX_SPAN_RECALL,   // by op from OP_RECORD
+                                             DMX_SPAN_UNDO, DMX_SPAN_REDO};
+            count = selected;                                   // the selection has no level, drop it
+            DmxSpan& span = spans[count++];
+            span.first = in.op == KeyProgram::OP_RECORD || in.op == KeyProgram::OP_RECALL ? in.first : 0;
+            span.count = 0;
+            span.universe = 0;
+            span.level = 0;
+            span.time = times[in.op - KeyProgram::OP_RECORD];
+            span.effect = EFFECT_NONE;
+            selected = count;
         }
     }
-    xQueueSend(dmxQueue, dmxFrame, portMAX_DELAY);
+
+    if (selected > 0) {
+        DmxSpan& span = spans[selected++];
+        memset(&span, 0, sizeof(span));
+        span.time = DMX_SPAN_COMMIT;                            // one undo step per command
+    }
+    if (uxQueueSpacesAvailable(dmxSpans) < selected)            // the only sender, so the room cannot shrink below
+        return KeyProgram::SUCCESS;                             // dropped whole, never half a command
+    for (size_t i = 0; i < selected; i++)                       // a selection with no level changes nothing
+        xQueueSend(dmxSpans, &spans[i], 0);
+    *queued = true;
+    wakeDmx(NULL);
+    return KeyProgram::SUCCESS;
 }
 
 /**
@@ -257,10 +578,36 @@ void wifi_init_task(void*) {
     }
     printf("IP Address: %s\n", ip4addr_ntoa(&netif_default->ip_addr));                  // print IP address
 
-    dmxQueue = xQueueCreate(5, 512);                                                    // create queue for DMX frames
-    dmx.begin(2);                                                                       // init DMX on pin 2
+#if DMX_PARALLEL_PORTS > 0
+    if (dmx.beginParallel(0, DMX_PARALLEL_PORTS, dmx_pins[0]) != DmxOutput::SUCCESS)   // init all universes as one parallel group
+        printf("DMX parallel group failed to start on pin %u\n", dmx_pins[0]);
+#else
+    for (uint u = 0; u < sizeof(dmx_pins) / sizeof(dmx_pins[0]); u++) {
+        if (dmx.begin(u, dmx_pins[u]) != DmxOutput::SUCCESS)                            // init one DMX port per universe
+            printf("DMX universe %u failed to start on pin %u\n", u + 1, dmx_pins[u]);
+    }
+#endif
+    dmxSpans = xQueueCreate(DMX_SPAN_QUEUE, sizeof(DmxSpan));                           // create queue for DMX channel changes
+    for (uint u = 0; u < dmx.universes(); u++) {
+        if (dmx.active(u)) {
+            layers[u] = new LayerStack();                                               // create level layers for each universe
+            networkMerge[u] = new SourceMerge();
+        }
+    }
+    if (sacn.begin(SACN_FIRST_UNIVERSE, dmx.universes(), wakeDmx, NULL) != SacnReceiver::SUCCESS)
+        printf("sACN receiver failed to start\n");
+    if (artnet.begin(ARTNET_FIRST_UNIVERSE, dmx.universes(), rfu_config.hostname, wakeDmx, NULL) != ArtNetNode::SUCCESS)
+        printf("Art-Net node failed to start\n");
+    for (uint i = 0; i < sizeof(dmx_in_pins) / sizeof(dmx_in_pins[0]); i++) {
+        if (inputs.begin(i, dmx_in_pins[i], wakeDmxFromISR, NULL) != DmxInput::SUCCESS)
+            printf("DMX input %u failed to start on pin %u\n", i + 1, dmx_in_pins[i]);
+    }
+    patchMaps = new Mailbox<PatchMap>();
+    patch.identity(dmx.universes());                                                    // keypad channels are DMX addresses until patched
+    publishPatch();
 
-    xTaskCreate(dmx_task, "DMX", 1024, NULL, 2, NULL);                                  // create task to listen for DMX frames
+    xTaskCreate(dmx_task, "DMX", 1024, NULL, 2, &dmxTask);                              // create task to listen for DMX changes
+    wakeDmx(NULL);                                                                      // for anything published before dmxTask was set
     xTaskCreate(mongoose_task, "mongoose", 2048, NULL, 2, NULL);                         // create task for mongoose
 
     vTaskDelete(NULL);
@@ -0,0 +1,266 @@
+#include "sacn.h"
+
+#include <string.h>
+
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "lwip/igmp.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include "pico/cyw43_arch.h"
+
+// Preamble size, postamble size and ACN packet identifier that open every packet
+static const uint8_t acnPreamble[16] = {0x00, 0x10, 0x00, 0x00, 'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0};
+
+static inline uint16_t get16(const uint8_t *p) {
+    return p[0] << 8 | p[1];
+}
+
+static inline uint32_t get32(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+SacnReceiver::SacnReceiver() : _pcb(nullptr), _first(1), _count(0), _notify(nullptr), _arg(nullptr),
+                               _packets(0), _late(0), _ignored(0), _mergeChannels(0), _mergeMicros(0),
+                               _mergePeakMicros(0), _lock(nullptr), _held(0), _syncGroup(0), _syncSeen(0),
+                               _syncs(0) {
+    memset(_frames, 0, sizeof(_frames));
+    memset(_merges, 0, sizeof(_merges));
+    memset(_syncAddress, 0, sizeof(_syncAddress));
+    memset(_published, 0, sizeof(_published));
+    memset(_sequence, 0, sizeof(_sequence));
+    memset(_started, 0, sizeof(_started));
+}
+
+/**
+ * @brief Starts listening on SACN_PORT and joins the multicast group of each universe
+ * @param first The sACN universe received into keypad universe 1
+ * @param count Universes to receive
+ * @param notify Called when a frame is waiting, may be nullptr
+ * @param arg Passed to notify
+ */
+SacnReceiver::return_code SacnReceiver::begin(uint16_t first, uint8_t count, notify_fn notify, void *arg) {
+    if (count == 0 || count > SACN_MAX_UNIVERSES)
+        return ERR_BAD_UNIVERSE;
+    if (_lock == nullptr)
+        _lock = spin_lock_instance(next_striped_spin_lock_num());
+    for (uint8_t u = 0; u < count; u++) {
+        if (_frames[u] == nullptr)
+            _frames[u] = new Mailbox<NetFrame>(_lock);
+        if (_merges[u] == nullptr)
+            _merges[u] = new PriorityMerge();
+    }
+    _first = first;
+    _notify = notify;
+    _arg = arg;
+    _count = count;
+
+    cyw43_arch_lwip_begin();
+    _pcb = udp_new();
+    if (_pcb == nullptr) {
+        cyw43_arch_lwip_end();
+        return ERR_NO_PCB;
+    }
+    if (udp_bind(_pcb, IP_ANY_TYPE, SACN_PORT) != ERR_OK) {
+        udp_remove(_pcb);
+        _pcb = nullptr;
+        cyw43_arch_lwip_end();
+        return ERR_BIND;
+    }
+    udp_recv(_pcb, received, this);
+    for (uint8_t u = 0; u < count; u++) {
+        uint16_t universe = first + u;
+        ip4_addr_t group;
+        IP4_ADDR(&group, 239, 255, universe >> 8, universe & 0xFF);
+        igmp_joingroup(IP4_ADDR_ANY4, &group);
+    }
+    cyw43_arch_lwip_end();
+    return SUCCESS;
+}
+
+void SacnReceiver::received(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, uint16_t port) {
+    ((SacnReceiver *)arg)->receive(p);
+    pbuf_free(p);
+}
+
+/**
+ * @brief Checks one packet and merges its levels or priorities
+ * @post The payload is read once, in place in the pbuf unless it is split
+ */
+void SacnReceiver::receive(struct pbuf *p) {
+    uint8_t buffer[SACN_HEADER_SIZE];
+    uint16_t length = p->tot_len < SACN_HEADER_SIZE ? p->tot_len : SACN_HEADER_SIZE;
+    const uint8_t *h = nullptr;
+    // Points into the pbuf unless the header is split across pbufs
+    if (length >= SACN_SYNC_SIZE)
+        h = (const uint8_t *)pbuf_get_contiguous(p, buffer, sizeof(buffer), length, 0);
+    if (h == nullptr || memcmp(h, acnPreamble, sizeof(acnPreamble)) != 0) {
+        _ignored++;
+        return;
+    }
+    uint32_t now = time_us_64() / 1000;
+    if (get32(h + SACN_ROOT_VECTOR) == SACN_VECTOR_ROOT_EXTENDED &&
+        get32(h + SACN_FRAMING_VECTOR) == SACN_VECTOR_FRAMING_SYNC) {
+        sync(get16(h + SACN_SYNC_UNIVERSE), now);
+        return;
+    }
+    if (length < SACN_HEADER_SIZE || get32(h + SACN_ROOT_VECTOR) != SACN_VECTOR_ROOT_DATA ||
+        get32(h + SACN_FRAMING_VECTOR) != SACN_VECTOR_FRAMING_DATA ||
+        h[SACN_DMP_VECTOR] != SACN_VECTOR_DMP_SET ||
+        (h[SACN_START_CODE] != SACN_START_LEVELS && h[SACN_START_CODE] != SACN_START_PRIORITY)) {
+        _ignored++;
+        return;
+    }
+    uint16_t u = get16(h + SACN_UNIVERSE) - _first;
+    uint16_t values = get16(h + SACN_PROPERTY_COUNT);         // the start code and the levels
+    if (u >= _count || values < 1 || values > NET_CHANNELS + 1 || p->tot_len < SACN_START_CODE + values ||
+        (h[SACN_OPTIONS] & SACN_OPTION_PREVIEW)) {
+        _ignored++;
+        return;
+    }
+
+    PriorityMerge &merge = *_merges[u];
+    merge.expire(now, SACN_TIMEOUT_MS);
+    bool fresh;
+    int s = merge.claim(h + SACN_CID, &fresh);
+    if (s < 0) {
+        _ignored++;
+        return;
+    }
+    if (fresh)
+        _started[u][s] = false;
+
+    // Anything up to 19 behind the source's last packet is late, further back it restarted
+    int8_t ahead = h[SACN_SEQUENCE] - _sequence[u][s];
+    if (_started[u][s] && ahead <= 0 && ahead > -20) {
+        _late++;
+        return;
+    }
+    _sequence[u][s] = h[SACN_SEQUENCE];
+    _started[u][s] = true;
+    _packets++;
+
+    uint32_t start = time_us_32();
+    uint16_t count = values - 1;
+    if (h[SACN_OPTIONS] & SACN_OPTION_TERMINATED) {
+        merge.drop(s);
+    } else {
+        const uint8_t *levels = _scratch;
+        if (count > 0)
+            levels = (const uint8_t *)pbuf_get_contiguous(p, _scratch, sizeof(_scratch), count, SACN_HEADER_SIZE);
+        if (h[SACN_START_CODE] == SACN_START_LEVELS)
+            merge.levels(s, levels, count, h[SACN_PRIORITY], now);
+        else
+            merge.priorities(s, levels, count, now);
+    }
+    _mergeMicros = time_us_32() - start;
+    if (_mergeMicros > _mergePeakMicros)
+        _mergePeakMicros = _mergeMicros;
+    _mergeChannels = merge.cost();
+
+    bool due = merge.changed() || now - _published[u] >= SACN_REPUBLISH_MS;
+    uint16_t address = get16(h + SACN_SYNC_ADDRESS);
+    _syncAddress[u] = address;
+    if (address != 0) {
+        join(address);
+        if (_syncs != 0 && now - _syncSeen <= SACN_TIMEOUT_MS) {
+            if (due)
+                _held |= 1u << u;       // published by the sync packet
+            return;
+        }
+    }
+    if (due || (_held & (1u << u)))
+        publish(u, now);
+}
+
+/**
+ * @brief Publishes every universe waiting on one sync packet, all at once
+ * @param address The synchronization universe the packet was sent for
+ */
+void SacnReceiver::sync(uint16_t address, uint32_t now_ms) {
+    _syncs++;
+    _syncSeen = now_ms;
+    uint32_t due = 0;
+    for (uint8_t u = 0; u < _count; u++) {
+        if ((_held & (1u << u)) && _syncAddress[u] == address) {
+            fill(u, now_ms);
+            due |= 1u << u;
+        }
+    }
+    if (due == 0)
+        return;
+    _held &= ~due;
+
+    bool waiting = false;
+    uint32_t save = spin_lock_blocking(_lock);
+    for (uint8_t u = 0; u < _count; u++) {
+        if (due & (1u << u))
+            waiting |= !_frames[u]->publishLocked();
+    }
+    spin_unlock(_lock, save);
+    if (waiting && _notify != nullptr)
+        _notify(_arg);                  // once for the lot
+}
+
+/**
+ * @brief Joins the multicast group sync packets for address are sent to
+ */
+void SacnReceiver::join(uint16_t address) {
+    if (address == _syncGroup)
+        return;
+    ip4_addr_t group;
+    if (_syncGroup != 0 && (uint16_t)(_syncGroup - _first) >= _count) {
+        IP4_ADDR(&group, 239, 255, _syncGroup >> 8, _syncGroup & 0xFF);
+        igmp_leavegroup(IP4_ADDR_ANY4, &group);
+    }
+    if ((uint16_t)(address - _first) >= _count) {
+        IP4_ADDR(&group, 239, 255, address >> 8, address & 0xFF);
+        igmp_joingroup(IP4_ADDR_ANY4, &group);   // a data universe's group is already joined
+    }
+    _syncGroup = address;
+}
+
+/**
+ * @brief Copies the merged levels of universe u into its mailbox slot
+ */
+void SacnReceiver::fill(uint8_t u, uint32_t now_ms) {
+    const PriorityMerge &merge = *_merges[u];
+    NetFrame *frame = _frames[u]->writeSlot();
+    frame->count = merge.count();
+    frame->priority = merge.priority();
+    frame->levels[0] = SACN_START_LEVELS;
+    memcpy(frame->levels + 1, merge.output(), frame->count);
+    _published[u] = now_ms;
+}
+
+/**
+ * @brief Hands the merged levels of universe u to dmx_task
+ */
+void SacnReceiver::publish(uint8_t u, uint32_t now_ms) {
+    fill(u, now_ms);
+    _held &= ~(1u << u);
+    if (!_frames[u]->publish() && _notify != nullptr)
+        _notify(_arg);                  // a superseded frame already woke the reader
+}
+
+uint32_t SacnReceiver::collect(NetFrame *frames[SACN_MAX_UNIVERSES]) {
+    uint8_t count = _count;
+    if (count == 0)
+        return 0;                       // not started
+    uint32_t fresh = 0;
+    uint32_t save = spin_lock_blocking(_lock);
+    for (uint8_t u = 0; u < count; u++) {
+        frames[u] = _frames[u]->latestLocked();
+        if (frames[u] != nullptr)
+            fresh |= 1u << u;
+    }
+    spin_unlock(_lock, save);
+    return fresh;
+}
+
+unsigned SacnReceiver::sources() const {
+    unsigned n = 0;
+    for (uint8_t u = 0; u < _count; u++)
+        n += _merges[u]->sources();
+    return n;
+}
@@ -0,0 +1,148 @@
+#ifndef _sacn_h_
+#define _sacn_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lwip/ip_addr.h"
+#include "mailbox.h"
+#include "netframe.h"
+#include "priority.h"
+
+#define SACN_PORT 5568
+#define SACN_MAX_UNIVERSES 8
+#define SACN_TIMEOUT_MS 2500            // E1.31 network data loss
+#define SACN_REPUBLISH_MS 1000          // unchanged levels are published this often, so dmx_task keeps them
+
+// Offsets into an E1.31 data packet, all fields big endian
+#define SACN_ROOT_VECTOR 18
+#define SACN_CID 22
+#define SACN_FRAMING_VECTOR 40
+#define SACN_PRIORITY 108
+#define SACN_SYNC_ADDRESS 109           // universe whose sync packet releases the data, 0 if none
+#define SACN_SEQUENCE 111
+#define SACN_OPTIONS 112
+#define SACN_UNIVERSE 113
+#define SACN_DMP_VECTOR 117
+#define SACN_PROPERTY_COUNT 123
+#define SACN_START_CODE 125
+#define SACN_HEADER_SIZE 126            // up to the first level
+
+// Offsets into an E1.31 synchronization packet
+#define SACN_SYNC_SEQUENCE 44
+#define SACN_SYNC_UNIVERSE 45
+#define SACN_SYNC_SIZE 49
+
+#define SACN_VECTOR_ROOT_DATA 0x00000004
+#define SACN_VECTOR_FRAMING_DATA 0x00000002
+#define SACN_VECTOR_ROOT_EXTENDED 0x00000008
+#define SACN_VECTOR_FRAMING_SYNC 0x00000001
+#define SACN_VECTOR_DMP_SET 0x02
+#define SACN_OPTION_PREVIEW 0x80
+#define SACN_OPTION_TERMINATED 0x40
+#define SACN_START_LEVELS 0x00
+#define SACN_START_PRIORITY 0xDD        // per-address priorities
+
+/*
+    Receives E1.31 (streaming ACN) on lwIP raw UDP. Universes first ..
+    first + count - 1 land in keypad universes 0 .. count - 1, through
+    their multicast groups or unicast.
+
+    A packet is checked from the header alone, then its levels, or its
+    per-address priorities, go straight from the pbuf into the universe's
+    PriorityMerge, which arbitrates the sources sending the universe by
+    CID and priority. The merged levels are published to the universe's
+    mailbox when they change, all in the lwIP thread with no frame held
+    on the stack. Packets older than the last one taken from their source
+    are dropped by their sequence number as E1.31 asks, as are preview
+    packets, and a source that stops or goes quiet for SACN_TIMEOUT_MS
+    hands its channels to the next in line.
+
+    Data that names a synchronization address is merged as it arrives
+    but held back from dmx_task until the sync packet for that address.
+    The sync packet then publishes every universe waiting on it under
+    one hold of the mailboxes' shared lock, and collect() takes them
+    under that same lock, so dmx_task sees either all of them or none.
+    While no sync packet has arrived for SACN_TIMEOUT_MS, data is
+    published as it comes, as E1.31 asks.
+*/
+class SacnReceiver {
+    public:
+    enum return_code {
+        SUCCESS = 0,
+
+        // lwIP has no UDP PCB to spare
+        ERR_NO_PCB = -1,
+
+        // The port is taken
+        ERR_BIND = -2,
+
+        // count is 0 or above SACN_MAX_UNIVERSES
+        ERR_BAD_UNIVERSE = -3
+    };
+
+    // Called in the lwIP thread when a frame is published to an empty mailbox
+    typedef void (*notify_fn)(void *arg);
+
+    SacnReceiver();
+
+    return_code begin(uint16_t first, uint8_t count, notify_fn notify, void *arg);
+
+    /*
+        The newest frame of each keypad universe, nullptr where nothing
+        new arrived since the last call, taken all at once so universes
+        released by one sync packet are never split. Frames stay valid
+        until the next call. Returns the universes with a new frame.
+    */
+    uint32_t collect(NetFrame *frames[SACN_MAX_UNIVERSES]);
+    uint16_t first() const {return _first;};
+    uint8_t count() const {return _count;};
+
+    uint32_t packets() const {return _packets;};
+    // Packets dropped for arriving out of order
+    uint32_t late() const {return _late;};
+    // Packets that are not E1.31 data, are for another universe, or are
+    // from a source the universe has no room for
+    uint32_t ignored() const {return _ignored;};
+    // Sources sending, over every universe
+    unsigned sources() const;
+    // Channels the last packet arbitrated again, and the time it took
+    uint16_t mergeChannels() const {return _mergeChannels;};
+    uint32_t mergeMicros() const {return _mergeMicros;};
+    uint32_t mergePeakMicros() const {return _mergePeakMicros;};
+    uint32_t syncs() const {return _syncs;};
+
+    private:
+    static void received(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, uint16_t port);
+    void receive(struct pbuf *p);
+    void sync(uint16_t address, uint32_t now_ms);
+    void join(uint16_t address);
+    void fill(uint8_t u, uint32_t now_ms);
+    void publish(uint8_t u, uint32_t now_ms);
+
+    struct udp_pcb *_pcb;
+    uint16_t _first;
+    uint8_t _count;
+    notify_fn _notify;
+    void *_arg;
+    Mailbox<NetFrame> *_frames[SACN_MAX_UNIVERSES];
+    PriorityMerge *_merges[SACN_MAX_UNIVERSES];
+    uint32_t _published[SACN_MAX_UNIVERSES];    // when each universe last published, in ms
+    uint8_t _sequence[SACN_MAX_UNIVERSES][PRIORITY_MAX_SOURCES];
+    bool _started[SACN_MAX_UNIVERSES][PRIORITY_MAX_SOURCES];
+    uint8_t _scratch[NET_CHANNELS];     // levels split across pbufs are gathered here
+    uint32_t _packets;
+    uint32_t _late;
+    uint32_t _ignored;
+    uint16_t _mergeChannels;
+    uint32_t _mergeMicros;
+    uint32_t _mergePeakMicros;
+    spin_lock_t *_lock;                 // shared by every mailbox
+    uint16_t _syncAddress[SACN_MAX_UNIVERSES];  // as named by each universe's last packet
+    uint32_t _held;                     // universes merged but waiting for their sync packet
+    uint16_t _syncGroup;                // sync universe whose multicast group was joined
+    uint32_t _syncSeen;                 // when the last sync packet arrived, in ms
+    uint32_t _syncs;
+};
+
+#endif // _sacn_h_
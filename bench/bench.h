@@ -0,0 +1,22 @@
+#ifndef _bench_h_
+#define _bench_h_
+
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+    Minimal timing helpers shared by the host benchmarks.
+*/
+static inline uint64_t bench_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Keeps the optimiser from discarding a computed value
+template <typename T>
+static inline void bench_keep(const T &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+#endif // _bench_h_
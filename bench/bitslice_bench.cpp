@@ -0,0 +1,49 @@
+#include <stdlib.h>
+
+#include "bench.h"
+#include "bitslice.h"
+
+// 8 full universes (start code + 512 slots) into one bit-sliced frame
+int main() {
+    const int rounds = 20000;
+    static uint8_t universes[BITSLICE_LANES][513];
+    static uint32_t sliced[2 * 513];
+    const uint8_t *lanes[BITSLICE_LANES];
+    for (int n = 0; n < BITSLICE_LANES; n++) {
+        for (int s = 0; s < 513; s++)
+            universes[n][s] = rand();
+        lanes[n] = universes[n];
+    }
+
+    // Check the layout once before timing it
+    const uint8_t *bytes = (const uint8_t *)sliced;
+    bitslice_transpose(lanes, sliced, 513);
+    for (int s = 0; s < 513; s++) {
+        for (int b = 0; b < 8; b++) {
+            for (int n = 0; n < BITSLICE_LANES; n++) {
+                if (((bytes[8 * s + b] >> n) & 1) != ((universes[n][s] >> b) & 1)) {
+                    printf("bitslice_bench: layout mismatch at slot %d bit %d lane %d\n", s, b, n);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    uint64_t worst = 0;
+    uint64_t start = bench_now_ns();
+    for (int r = 0; r < rounds; r++) {
+        uint64_t t0 = bench_now_ns();
+        bitslice_transpose(lanes, sliced, 513);
+        uint64_t dt = bench_now_ns() - t0;
+        bench_keep(sliced);
+        if (dt > worst)
+            worst = dt;
+    }
+    uint64_t total = bench_now_ns() - start;
+
+    printf("bitslice_bench: 8 x 513 slot frames x %d rounds\n", rounds);
+    printf("  mean transpose  : %.2f us\n", total / 1e3 / rounds);
+    printf("  per slot        : %.2f ns\n", (double)total / rounds / 513);
+    printf("  worst transpose : %.2f us\n", worst / 1e3);
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include "bench.h"
+#include "curves.h"
+
+#include <string.h>
+
+// Dimmer curves applied to a full 512 slot frame, as done once per new frame
+int main() {
+    const int rounds = 20000;
+    const size_t length = 513;
+    static CurveLut luts[CURVE_COUNT] = {curve_linear, curve_square, curve_inv_square, curve_scurve};
+    static uint8_t curve[length];
+    static uint8_t in[length];
+    static uint8_t out[length];
+
+    for (int c = CURVE_CUSTOM; c < CURVE_COUNT; c++)
+        luts[c] = curve_linear;
+
+    // Mixed rig: every curve in use, start code linear
+    for (size_t i = 1; i < length; i++) {
+        curve[i] = i % CURVE_COUNT;
+        in[i] = i * 7;
+    }
+
+    // Check every slot against the generator
+    curve_apply(luts, curve, in, out, length);
+    for (size_t i = 0; i < length; i++) {
+        uint8_t want = curve[i] >= CURVE_CUSTOM ? in[i] : curve_point((dimmer_curve)curve[i], in[i]);
+        if (out[i] != want) {
+            printf("curve_bench: slot %zu curve %u gave %u for %u, want %u\n", i, curve[i], out[i], in[i], want);
+            return 1;
+        }
+    }
+
+    uint64_t curveTotal = 0;
+    uint64_t copyTotal = 0;
+    uint64_t worst = 0;
+    for (int r = 0; r < rounds; r++) {
+        in[1 + r % 512] ^= 0x55;
+        uint64_t t0 = bench_now_ns();
+        curve_apply(luts, curve, in, out, length);
+        uint64_t dt = bench_now_ns() - t0;
+        bench_keep(out);
+        curveTotal += dt;
+        if (dt > worst)
+            worst = dt;
+
+        // The same frame sent linear is a plain copy, for comparison
+        t0 = bench_now_ns();
+        memcpy(out, in, length);
+        bench_keep(out);
+        copyTotal += bench_now_ns() - t0;
+    }
+
+    printf("curve_bench: %zu slot frame x %d frames\n", length - 1, rounds);
+    printf("  mean frame      : %.2f us\n", curveTotal / 1e3 / rounds);
+    printf("  per slot        : %.2f ns\n", (double)curveTotal / rounds / length);
+    printf("  worst frame     : %.2f us\n", worst / 1e3);
+    printf("  linear memcpy   : %.2f us\n", copyTotal / 1e3 / rounds);
+    return 0;
+}
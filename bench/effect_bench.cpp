@@ -0,0 +1,72 @@
+#include "bench.h"
+#include "effects.h"
+
+#include <string.h>
+
+// 64 effects of 8 channels each covering one universe, stepped every 10ms
+int main() {
+    const int rounds = 20000;
+    const uint32_t tickMs = 10;
+    static uint8_t universe[EFFECT_CHANNELS + 1];
+    static ChannelSet dirty;
+    uint8_t *frames[EFFECT_MAX_UNIVERSES] = {universe};
+    ChannelSet *dirties[EFFECT_MAX_UNIVERSES] = {&dirty};
+    static EffectEngine effects;
+
+    // Check a chase lights exactly one channel at a time and keeps its
+    // phase when stopped in the middle
+    effects.start(0, 1, 8, EFFECT_CHASE, 200, 800);
+    for (uint32_t t = 0; t < 1600; t += tickMs) {
+        effects.step(tickMs, frames);
+        if (t == 400) {
+            effects.stop(0, 4, 5);
+            universe[4] = universe[5] = 0;      // released from the layer by the caller
+        }
+        unsigned lit = 0;
+        for (unsigned ch = 1; ch <= 8; ch++)
+            lit += universe[ch] == 200;
+        // Once split, nothing is lit while the chase is on the stopped channels
+        uint32_t step = (t + tickMs) % 800 / 100;
+        bool stopped = t >= 400 && (step == 3 || step == 4);
+        if (lit != (stopped ? 0u : 1u)) {
+            printf("effect_bench: %u chase channels lit at %u ms\n", lit, t);
+            return 1;
+        }
+    }
+    if (effects.active() != 2) {
+        printf("effect_bench: %zu effects after splitting a chase, want 2\n", effects.active());
+        return 1;
+    }
+    effects.stop(0, 1, EFFECT_CHANNELS);
+    if (effects.active() != 0) {
+        printf("effect_bench: %zu effects left after stopping all\n", effects.active());
+        return 1;
+    }
+
+    for (unsigned e = 0; e < EFFECT_MAX_SLOTS; e++) {
+        effect_wave wave = (effect_wave)(EFFECT_CHASE + e % (EFFECT_FLICKER - EFFECT_CHASE + 1));
+        effects.start(0, 1 + e * 8, 8 + e * 8, wave, 255, 500 + e * 37);
+    }
+
+    uint64_t total = 0;
+    uint64_t worst = 0;
+    uint64_t written = 0;
+    for (int r = 0; r < rounds; r++) {
+        dirty.clear();
+        uint64_t t0 = bench_now_ns();
+        effects.step(tickMs, frames, dirties);
+        uint64_t dt = bench_now_ns() - t0;
+        bench_keep(universe);
+        total += dt;
+        written += dirty.count();
+        if (dt > worst)
+            worst = dt;
+    }
+
+    printf("effect_bench: %d effects over %d channels x %d steps\n", EFFECT_MAX_SLOTS, EFFECT_CHANNELS, rounds);
+    printf("  mean step       : %.2f us\n", total / 1e3 / rounds);
+    printf("  per channel     : %.2f ns\n", (double)total / rounds / EFFECT_CHANNELS);
+    printf("  worst step      : %.2f us\n", worst / 1e3);
+    printf("  changed / step  : %.1f channels\n", (double)written / rounds);
+    return 0;
+}
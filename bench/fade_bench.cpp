@@ -0,0 +1,59 @@
+#include "bench.h"
+#include "fade.h"
+
+// 512 channels of one universe all fading at once, stepped once per frame
+int main() {
+    const int rounds = 200;
+    const uint32_t fadeMs = 3000;
+    const uint32_t frameMs = 23;                // a full universe frame
+    static uint8_t universe[FADE_CHANNELS + 1];
+    uint8_t *frames[FADE_MAX_UNIVERSES] = {universe};
+    static FadeEngine fades;
+
+    // Check a fade lands on its target and is monotonic on the way
+    fades.start(0, 1, 10, 250, fadeMs);
+    uint8_t prev = 10;
+    for (uint32_t t = 0; t < fadeMs; t += frameMs) {
+        fades.step(frameMs, frames);
+        if (universe[1] < prev) {
+            printf("fade_bench: level fell from %u to %u\n", prev, universe[1]);
+            return 1;
+        }
+        prev = universe[1];
+    }
+    if (universe[1] != 250 || fades.active() != 0) {
+        printf("fade_bench: fade ended at %u with %zu fades left\n", universe[1], fades.active());
+        return 1;
+    }
+
+    uint64_t startTotal = 0;
+    uint64_t stepTotal = 0;
+    uint64_t worst = 0;
+    size_t steps = 0;
+    for (int r = 0; r < rounds; r++) {
+        uint64_t t0 = bench_now_ns();
+        for (uint16_t ch = 1; ch <= FADE_CHANNELS; ch++)
+            fades.start(0, ch, universe[ch], (r & 1) ? 0 : 255, fadeMs);
+        startTotal += bench_now_ns() - t0;
+
+        // Stop one frame short so every fade stays active while timed
+        for (uint32_t t = frameMs; t < fadeMs; t += frameMs) {
+            uint64_t s0 = bench_now_ns();
+            fades.step(frameMs, frames);
+            uint64_t dt = bench_now_ns() - s0;
+            bench_keep(universe);
+            stepTotal += dt;
+            steps++;
+            if (dt > worst)
+                worst = dt;
+        }
+        fades.step(fadeMs, frames);
+    }
+
+    printf("fade_bench: %d simultaneous fades x %zu frames\n", FADE_CHANNELS, steps);
+    printf("  mean step       : %.2f us\n", stepTotal / 1e3 / steps);
+    printf("  per fade        : %.2f ns\n", (double)stepTotal / steps / FADE_CHANNELS);
+    printf("  worst step      : %.2f us\n", worst / 1e3);
+    printf("  start 512 fades : %.2f us\n", startTotal / 1e3 / rounds);
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include <string.h>
+
+#include "bench.h"
+#include "keypad.h"
+
+// Command lines as sent by fs/keypad.js (numbers zero padded to 3 digits)
+static const char *corpus[] = {
+    "001 AT FULL",
+    "001 AT 000",
+    "001 THRU 512 AT 050",
+    "001 THRU 512 AT FULL",
+    "010 AND 012 AND 014 AT 128",
+    "001 THRU 024 AND 101 THRU 124 AT 200",
+    "047 AT 255",
+    "047 AT 000",
+    "048 AT 255",
+    "100 FULL",
+    "release",
+    "001 AND 002 AND 003 AND 004 AND 005 AND 006 AND 007 AND 008 AT 064",
+    "201 THRU 212 AT 075 AND 301 THRU 312 AT 025",
+    "512 THRU 001 AT 010",
+    "033 THRU 048 AT FULL",
+    "2/001 THRU 2/512 AT 100",
+    "1/010 AND 3/010 AND 8/010 AT FULL",
+    "001 THRU 512 AT 050 TIME 3",
+    "047 AT FULL TIME 2.5",
+};
+static const size_t corpusSize = sizeof(corpus) / sizeof(corpus[0]);
+
+int main() {
+    const int rounds = 200000;
+    size_t lengths[corpusSize];
+    for (size_t i = 0; i < corpusSize; i++)
+        lengths[i] = strlen(corpus[i]);
+
+    KeyProgram program;
+    uint64_t worst = 0;
+    size_t worstCmd = 0;
+    uint64_t start = bench_now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < corpusSize; i++) {
+            uint64_t t0 = bench_now_ns();
+            program.parse(corpus[i], lengths[i]);
+            uint64_t dt = bench_now_ns() - t0;
+            bench_keep(program);
+            if (dt > worst) {
+                worst = dt;
+                worstCmd = i;
+            }
+        }
+    }
+    uint64_t total = bench_now_ns() - start;
+    double commands = (double)rounds * corpusSize;
+
+    printf("keypad_bench: %zu command lines x %d rounds\n", corpusSize, rounds);
+    printf("  commands/s      : %.0f\n", commands / (total / 1e9));
+    printf("  mean parse      : %.1f ns\n", total / commands);
+    printf("  worst parse     : %llu ns (\"%s\")\n", (unsigned long long)worst, corpus[worstCmd]);
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include "bench.h"
+#include "looks.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SHOW_CUES 300
+#define SHOW_UNIVERSES 2
+#define CUE_BYTES_MAX 4096         // a cue never spans a flash sector
+
+/*
+    A cue of a typical rig: universe 1 holds 64 eight channel fixtures,
+    universe 2 holds 512 dimmers. Each cue brings up a few fixtures and
+    a few groups of neighbouring dimmers, about 10% of the channels.
+*/
+static void makeCue(uint8_t frames[LOOK_UNIVERSES][LOOK_CHANNELS + 1]) {
+    memset(frames, 0, LOOK_UNIVERSES * (LOOK_CHANNELS + 1));
+    for (int f = 0; f < 6; f++) {
+        unsigned base = 1 + (rand() % 64) * 8;
+        for (unsigned ch = 0; ch < 8; ch++)
+            frames[0][base + ch] = ch == 7 ? 0 : 1 + rand() % 255;     // dimmer, colour, pan, tilt..., no strobe
+    }
+    for (int g = 0; g < 6; g++) {
+        unsigned base = 1 + rand() % (LOOK_CHANNELS - 8);
+        for (unsigned ch = 0; ch < 6; ch++)
+            frames[1][base + ch] = 1 + rand() % 255;
+    }
+}
+
+int main() {
+    const int rounds = 20;
+    static uint8_t show[SHOW_CUES][LOOK_UNIVERSES][LOOK_CHANNELS + 1];
+    static uint8_t encoded[SHOW_CUES][CUE_BYTES_MAX];
+    static size_t length[SHOW_CUES];
+    static uint8_t out[LOOK_UNIVERSES][LOOK_CHANNELS + 1];
+    uint8_t *outs[LOOK_UNIVERSES];
+    for (unsigned u = 0; u < LOOK_UNIVERSES; u++)
+        outs[u] = out[u];
+
+    srand(1);
+    size_t lit = 0;
+    size_t total = 0;
+    uint64_t encodeTotal = 0;
+    for (int c = 0; c < SHOW_CUES; c++) {
+        makeCue(show[c]);
+        const uint8_t *frames[LOOK_UNIVERSES] = {nullptr};
+        for (unsigned u = 0; u < SHOW_UNIVERSES; u++) {
+            frames[u] = show[c][u];
+            for (unsigned ch = 1; ch <= LOOK_CHANNELS; ch++)
+                lit += show[c][u][ch] != 0;
+        }
+        uint64_t t0 = bench_now_ns();
+        LookCursor at;
+        length[c] = look_encode(frames, at, encoded[c], sizeof(encoded[c]));
+        encodeTotal += bench_now_ns() - t0;
+        total += length[c];
+
+        // Every cue must decode back to exactly what was encoded
+        memset(out, 0, sizeof(out));
+        look_decode(encoded[c], length[c], outs);
+        if (length[c] != look_size(frames) || memcmp(out, show[c], sizeof(out)) != 0) {
+            printf("look_bench: cue %d does not decode to its look\n", c);
+            return 1;
+        }
+    }
+
+    uint64_t decodeTotal = 0;
+    uint64_t worst = 0;
+    for (int r = 0; r < rounds; r++) {
+        for (int c = 0; c < SHOW_CUES; c++) {
+            uint64_t t0 = bench_now_ns();
+            look_decode(encoded[c], length[c], outs);
+            uint64_t dt = bench_now_ns() - t0;
+            bench_keep(out);
+            decodeTotal += dt;
+            if (dt > worst)
+                worst = dt;
+        }
+    }
+
+    printf("look_bench: %d cues over %d universes, %.1f lit channels each\n", SHOW_CUES, SHOW_UNIVERSES,
+           (double)lit / SHOW_CUES);
+    printf("  full frames     : %zu bytes\n", (size_t)SHOW_CUES * SHOW_UNIVERSES * (LOOK_CHANNELS + 1));
+    printf("  channel entries : %zu bytes\n", lit * 4);
+    printf("  runs            : %zu bytes (%.1f per cue)\n", total, (double)total / SHOW_CUES);
+    printf("  mean encode     : %.2f us\n", encodeTotal / 1e3 / SHOW_CUES);
+    printf("  mean decode     : %.2f us\n", decodeTotal / 1e3 / (rounds * SHOW_CUES));
+    printf("  worst decode    : %.2f us\n", worst / 1e3);
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include "bench.h"
+#include "masters.h"
+
+// One fader move: rebuild a universe's scale table, then apply it to a frame
+int main() {
+    const int rounds = 20000;
+    static MasterBank masters;
+    static uint8_t scale[CHANSET_CHANNELS + 1];
+    static uint8_t curve[CHANSET_CHANNELS + 1];
+    static uint8_t in[CHANSET_CHANNELS + 1];
+    static uint8_t out[CHANSET_CHANNELS + 1];
+    static CurveLut luts[CURVE_COUNT] = {curve_linear};
+
+    // Every submaster holds 64 channels, overlapping its neighbours by half
+    for (unsigned s = 0; s < MASTER_SUBMASTERS; s++)
+        masters.assign(s, 0, 1 + s * 32, 64 + s * 32 > CHANSET_CHANNELS ? CHANSET_CHANNELS : 64 + s * 32);
+    for (unsigned ch = 1; ch <= CHANSET_CHANNELS; ch++)
+        in[ch] = 255;
+
+    // Check a doubly mastered channel against the direct product
+    masters.setGrand(128);
+    masters.setLevel(0, 64);
+    masters.setLevel(1, 200);
+    masters.build(0, scale);
+    curve_apply_scaled(luts, curve, scale, in, out, sizeof(out));
+    uint8_t want = scale8(scale8(scale8(255, 128), 64), 200);
+    if (out[40] != want || out[0] != 0 || scale[0] != MASTER_FULL || out[500] != 128) {
+        printf("master_bench: channel 40 is %u, want %u\n", out[40], want);
+        return 1;
+    }
+    if (masters.stale() & 1u) {
+        printf("master_bench: universe still stale after build\n");
+        return 1;
+    }
+
+    uint64_t buildTotal = 0;
+    uint64_t applyTotal = 0;
+    uint64_t worst = 0;
+    for (int r = 0; r < rounds; r++) {
+        for (unsigned s = 0; s < MASTER_SUBMASTERS; s++)
+            masters.setLevel(s, (r + s * 31) & 0xFF);
+        uint64_t t0 = bench_now_ns();
+        masters.build(0, scale);
+        uint64_t dt = bench_now_ns() - t0;
+        bench_keep(scale);
+        buildTotal += dt;
+        if (dt > worst)
+            worst = dt;
+
+        t0 = bench_now_ns();
+        curve_apply_scaled(luts, curve, scale, in, out, sizeof(out));
+        bench_keep(out);
+        applyTotal += bench_now_ns() - t0;
+    }
+
+    printf("master_bench: grand + %d submasters over 512 channels x %d moves\n", MASTER_SUBMASTERS, rounds);
+    printf("  mean build      : %.2f us\n", buildTotal / 1e3 / rounds);
+    printf("  worst build     : %.2f us\n", worst / 1e3);
+    printf("  mean apply      : %.2f us\n", applyTotal / 1e3 / rounds);
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "merge.h"
+
+// Scalar model of one merge: HTP is the highest active level, LTP follows
+// the source that last changed the channel
+struct Reference {
+    uint8_t levels[MERGE_MAX_SOURCES][MERGE_CHANNELS];
+    uint8_t owner[MERGE_CHANNELS];
+    bool active[MERGE_MAX_SOURCES];
+
+    void update(unsigned s, const uint8_t *in) {
+        for (unsigned c = 0; c < MERGE_CHANNELS; c++) {
+            if (in[c] != levels[s][c])
+                owner[c] = s;
+            levels[s][c] = in[c];
+        }
+        active[s] = true;
+    };
+    uint8_t out(unsigned c, bool ltp) const {
+        uint8_t v = 0;
+        for (unsigned s = 0; s < MERGE_MAX_SOURCES; s++) {
+            if (!active[s])
+                continue;
+            if (ltp ? owner[c] == s : levels[s][c] > v)
+                v = levels[s][c];
+        }
+        return v;
+    };
+};
+
+// 4 sources into 512 slots, half the universe HTP and half LTP
+int main() {
+    const int rounds = 100000;
+    static uint8_t frames[MERGE_MAX_SOURCES][MERGE_CHANNELS];
+    static Reference ref;
+    static SourceMerge merge;
+    memset(&ref, 0, sizeof(ref));
+    merge.setLTP(257, 512, true);
+
+    // Check against the scalar model, including levels that differ only
+    // in the high bit and updates that change a few channels at a time
+    const uint8_t edges[] = {0, 1, 0x7F, 0x80, 0x81, 0xFE, 0xFF};
+    for (int r = 0; r < 200; r++) {
+        unsigned s = r % MERGE_MAX_SOURCES;
+        for (unsigned c = 0; c < MERGE_CHANNELS; c++) {
+            if (r < 8 || rand() % 8 == 0)
+                frames[s][c] = rand() % 2 ? rand() : edges[rand() % sizeof(edges)];
+        }
+        merge.update(s, frames[s], MERGE_CHANNELS, r);
+        ref.update(s, frames[s]);
+        merge.merge();
+        for (unsigned c = 0; c < MERGE_CHANNELS; c++) {
+            if (merge.level(c + 1) != ref.out(c, c >= 256)) {
+                printf("merge_bench: channel %u is %u, expected %u\n", c + 1, merge.level(c + 1), ref.out(c, c >= 256));
+                return 1;
+            }
+        }
+    }
+
+    ChannelSet changed;
+    uint64_t worst = 0;
+    uint64_t start = bench_now_ns();
+    for (int r = 0; r < rounds; r++) {
+        frames[r % MERGE_MAX_SOURCES][r % MERGE_CHANNELS]++;
+        merge.update(r % MERGE_MAX_SOURCES, frames[r % MERGE_MAX_SOURCES], MERGE_CHANNELS, r);
+        uint64_t t0 = bench_now_ns();
+        merge.merge(&changed);
+        uint64_t dt = bench_now_ns() - t0;
+        bench_keep(changed);
+        if (dt > worst)
+            worst = dt;
+    }
+    uint64_t total = bench_now_ns() - start;
+
+    uint64_t t0 = bench_now_ns();
+    for (int r = 0; r < rounds; r++) {
+        merge.merge(&changed);
+        bench_keep(changed);
+    }
+    uint64_t mergeOnly = bench_now_ns() - t0;
+
+    printf("merge_bench: %d sources x %d slots x %d rounds\n", MERGE_MAX_SOURCES, MERGE_CHANNELS, rounds);
+    printf("  update + merge  : %.2f us\n", total / 1e3 / rounds);
+    printf("  merge           : %.2f us\n", mergeOnly / 1e3 / rounds);
+    printf("  per slot        : %.2f ns\n", (double)mergeOnly / rounds / MERGE_CHANNELS);
+    printf("  worst merge     : %.2f us\n", worst / 1e3);
+    return 0;
+}
@@ -0,0 +1,177 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "priority.h"
+
+// Scalar model of the E1.31 merge: every channel looks at every source
+struct Reference {
+    struct Source {
+        bool active;
+        bool perAddress;
+        uint8_t priority;
+        unsigned count;
+        uint32_t stamp;
+        uint32_t addressStamp;
+        uint8_t levels[PRIORITY_CHANNELS];
+        uint8_t address[PRIORITY_CHANNELS];
+    } sources[PRIORITY_MAX_SOURCES];
+
+    int rank(const Source &s, unsigned c) const {
+        if (!s.active || c >= s.count || (s.perAddress && s.address[c] == 0))
+            return 0;
+        uint8_t p = s.perAddress ? s.address[c] : s.priority;
+        return (p > PRIORITY_MAX ? PRIORITY_MAX : p) + 1;
+    };
+    uint8_t out(unsigned c) const {
+        int best = 0;
+        uint8_t level = 0;
+        for (unsigned s = 0; s < PRIORITY_MAX_SOURCES; s++) {
+            int r = rank(sources[s], c);
+            if (r > best || (r == best && r != 0 && sources[s].levels[c] > level)) {
+                best = r;
+                level = sources[s].levels[c];
+            }
+        }
+        return level;
+    };
+    unsigned count() const {
+        unsigned n = 0;
+        for (unsigned s = 0; s < PRIORITY_MAX_SOURCES; s++) {
+            if (sources[s].active && sources[s].count > n)
+                n = sources[s].count;
+        }
+        return n;
+    };
+    void expire(uint32_t now, uint32_t timeout) {
+        for (unsigned s = 0; s < PRIORITY_MAX_SOURCES; s++) {
+            if (sources[s].active && now - sources[s].stamp > timeout)
+                sources[s].active = false;
+            else if (sources[s].perAddress && now - sources[s].addressStamp > timeout)
+                sources[s].perAddress = false;
+        }
+    };
+};
+
+// Random packets from five consoles sharing four entries, compared with the model after each one
+static int check() {
+    static PriorityMerge merge;
+    static Reference ref;
+    memset(&ref, 0, sizeof(ref));
+    uint8_t owner[PRIORITY_MAX_SOURCES] = {0};
+    uint32_t now = 0;
+    for (int r = 0; r < 100000; r++) {
+        now += rand() % 50;
+        merge.expire(now, 2500);
+        ref.expire(now, 2500);
+
+        uint8_t cid[PRIORITY_CID_SIZE] = {0};
+        cid[0] = rand() % 5;
+        bool fresh;
+        int s = merge.claim(cid, &fresh);
+        if (s < 0)
+            continue;
+        Reference::Source &src = ref.sources[s];
+        if (fresh) {
+            memset(&src, 0, sizeof(src));
+            src.active = true;
+            owner[s] = cid[0];
+        } else if (owner[s] != cid[0]) {
+            printf("priority_bench: source %d claimed by two CIDs\n", s);
+            return 1;
+        }
+
+        unsigned count = rand() % 4 ? PRIORITY_CHANNELS : rand() % (PRIORITY_CHANNELS + 1);
+        uint8_t data[PRIORITY_CHANNELS];
+        int kind = rand() % 10;
+        if (kind < 6) {
+            uint8_t priority = rand() % 4 ? 100 : rand() % 256;
+            for (unsigned c = 0; c < count; c++)
+                data[c] = rand() % 3 ? src.levels[c] : rand();
+            merge.levels(s, data, count, priority, now);
+            memset(src.levels, 0, sizeof(src.levels));
+            memcpy(src.levels, data, count);
+            src.count = count;
+            src.priority = priority;
+            src.stamp = now;
+        } else if (kind < 9) {
+            for (unsigned c = 0; c < count; c++)
+                data[c] = rand() % 3 ? src.address[c] : rand() % 4 ? rand() % (PRIORITY_MAX + 1) : rand();
+            merge.priorities(s, data, count, now);
+            memset(src.address, 0, sizeof(src.address));
+            memcpy(src.address, data, count);
+            src.perAddress = true;
+            src.stamp = src.addressStamp = now;
+        } else {
+            merge.drop(s);
+            src.active = false;
+            memset(src.levels, 0, sizeof(src.levels));
+        }
+
+        if (merge.count() != ref.count()) {
+            printf("priority_bench: count is %u, expected %u\n", merge.count(), ref.count());
+            return 1;
+        }
+        for (unsigned c = 0; c < PRIORITY_CHANNELS; c++) {
+            if (merge.output()[c] != ref.out(c)) {
+                printf("priority_bench: channel %u is %u, expected %u\n", c + 1, merge.output()[c], ref.out(c));
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+    One workload: a primary and a backup console on one universe, each
+    sending a full frame per packet with a few channels moving.
+*/
+static void run(const char *name, uint8_t backupPriority, bool perAddress, unsigned moving) {
+    const int packets = 100000;
+    static PriorityMerge merge;
+    merge = PriorityMerge();
+    static uint8_t frames[2][PRIORITY_CHANNELS];
+    uint8_t address[PRIORITY_CHANNELS];
+    for (unsigned c = 0; c < PRIORITY_CHANNELS; c++) {
+        frames[0][c] = frames[1][c] = rand();
+        address[c] = c % 2 ? 150 : 50;
+    }
+    uint8_t cid[2][PRIORITY_CID_SIZE] = {{1}, {2}};
+    bool fresh;
+    int s[2] = {merge.claim(cid[0], &fresh), merge.claim(cid[1], &fresh)};
+    if (perAddress)
+        merge.priorities(s[1], address, PRIORITY_CHANNELS, 0);
+
+    uint64_t cost = 0;
+    uint64_t worst = 0;
+    uint64_t start = bench_now_ns();
+    for (int p = 0; p < packets; p++) {
+        unsigned i = p % 2;
+        for (unsigned m = 0; m < moving; m++)
+            frames[i][(p * 7 + m * 61) % PRIORITY_CHANNELS]++;
+        uint64_t t0 = bench_now_ns();
+        merge.levels(s[i], frames[i], PRIORITY_CHANNELS, i ? backupPriority : 100, p);
+        uint64_t dt = bench_now_ns() - t0;
+        bench_keep(merge.output()[p % PRIORITY_CHANNELS]);
+        cost += merge.cost();
+        if (dt > worst)
+            worst = dt;
+    }
+    uint64_t total = bench_now_ns() - start;
+    printf("  %-16s: %.2f us/packet, %.1f channels arbitrated, worst %.2f us\n", name,
+           total / 1e3 / packets, (double)cost / packets, worst / 1e3);
+}
+
+// Up to PRIORITY_MAX_SOURCES sACN sources merging into one 512 slot universe
+int main() {
+    if (check() != 0)
+        return 1;
+    printf("priority_bench: %d sources x %d slots, checked against a scan of every source\n",
+           PRIORITY_MAX_SOURCES, PRIORITY_CHANNELS);
+    run("unchanged", 100, false, 0);
+    run("8 moving", 100, false, 8);
+    run("backup below", 50, false, 8);
+    run("per-address", 100, true, 8);
+    run("all moving", 100, false, PRIORITY_CHANNELS);
+    return 0;
+}
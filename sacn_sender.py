@@ -0,0 +1,60 @@
+# Stand-in E1.31 (sACN) source for testing the receiver without a console.
+# Sends a chase across every channel of each universe at 44 frames a second:
+#   python3 sacn_sender.py --universes 8 --target 192.168.4.1
+# Run a second one with a different --priority to stand in for a backup console.
+# With --sync, every frame is released by an E1.31 synchronization packet.
+import argparse
+import socket
+import struct
+import time
+import uuid
+
+SACN_PORT = 5568
+
+
+def data_packet(cid, universe, sequence, levels, priority=100, terminated=False, sync=0):
+    slots = bytes([0]) + bytes(levels)                      # start code 0, then the levels
+    dmp = struct.pack("!HBBHHH", 0x7000 | (10 + len(slots)), 0x02, 0xA1, 0, 1, len(slots)) + slots
+    framing = struct.pack("!HI64sBHBBH", 0x7000 | (77 + len(dmp)), 0x00000002, b"rfu sacn_sender",
+                          priority, sync, sequence, 0x40 if terminated else 0, universe) + dmp
+    root = struct.pack("!HI16s", 0x7000 | (22 + len(framing)), 0x00000004, cid) + framing
+    return struct.pack("!HH12s", 0x0010, 0, b"ASC-E1.17\0\0\0") + root
+
+
+def sync_packet(cid, sync, sequence):
+    framing = struct.pack("!HIBHH", 0x7000 | 11, 0x00000001, sequence, sync, 0)
+    root = struct.pack("!HI16s", 0x7000 | (22 + len(framing)), 0x00000008, cid) + framing
+    return struct.pack("!HH12s", 0x0010, 0, b"ASC-E1.17\0\0\0") + root
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Stand-in E1.31 source")
+    parser.add_argument("--universes", type=int, default=1)
+    parser.add_argument("--first", type=int, default=1, help="first sACN universe")
+    parser.add_argument("--target", help="unicast address, multicast if left out")
+    parser.add_argument("--rate", type=float, default=44.0, help="frames a second")
+    parser.add_argument("--seconds", type=float, default=10.0)
+    parser.add_argument("--priority", type=int, default=100, help="universe priority, 0 to 200")
+    parser.add_argument("--sync", type=int, default=0, help="synchronization universe, 0 for none")
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, 4)
+    cid = uuid.uuid4().bytes
+    sequence = 0
+    frames = int(args.seconds * args.rate)
+    for frame in range(frames + 1):
+        last = frame == frames
+        for u in range(args.first, args.first + args.universes):
+            levels = [255 if ch == frame % 512 else 0 for ch in range(512)]
+            target = args.target or "239.255.%d.%d" % (u >> 8, u & 0xFF)
+            sock.sendto(data_packet(cid, u, sequence, levels, args.priority, last, args.sync), (target, SACN_PORT))
+        if args.sync:
+            target = args.target or "239.255.%d.%d" % (args.sync >> 8, args.sync & 0xFF)
+            sock.sendto(sync_packet(cid, args.sync, sequence), (target, SACN_PORT))
+        sequence = (sequence + 1) & 0xFF
+        time.sleep(1.0 / args.rate)
+
+
+if __name__ == "__main__":
+    main()